@@ -5,10 +5,67 @@
 //
 
 #include <vector>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_set>
+#include <algorithm>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
 #include <cmath>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "WavefrontOBJ.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+	#define OBJ_USE_MMAP
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <dirent.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define OBJ_USE_SSE
+	#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+	#define OBJ_USE_AVX
+	#include <immintrin.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static double GetSeconds(const Clock::time_point &begin, const Clock::time_point &end)
+{
+	return std::chrono::duration<double>(end - begin).count();
+}
+
+static double MeasureClockOverhead( void )
+{
+	double overhead = 1.0;
+	for (int i = 0; i < 16; ++i) {
+		const Clock::time_point begin = Clock::now();
+		overhead = std::min(overhead, GetSeconds(begin, Clock::now()));
+	}
+	return overhead;
+}
+
+// adds the time of a sampled line to a phase, see OBJ::LoadStats
+// the cost of reading the clock is subtracted (it would otherwise be scaled up with the sample)
+// samples that take longer than any line should are dropped, the thread was most likely preempted
+static void AddSample(double *seconds, int phase, const Clock::time_point &begin, const Clock::time_point &end)
+{
+	static const double MAX_SAMPLE_SECONDS = 1e-4;
+	static const double CLOCK_OVERHEAD = MeasureClockOverhead();
+	const double elapsed = GetSeconds(begin, end);
+	if (elapsed < MAX_SAMPLE_SECONDS) {
+		seconds[phase] += std::max(elapsed - CLOCK_OVERHEAD, 0.0) * OBJ::LoadStats::SAMPLE_INTERVAL;
+	}
+}
+
 OBJ::Material::Material( void )
 {
 	name = "default";
@@ -26,637 +83,3345 @@ OBJ::Material::Material( void )
 	sharpness = 60;
 	illumination = Material::DIFFUSE;
 	// map_Kx, disp, decal & bump have no defaults
+	validMaps = 0;
 }
 
-OBJ::OBJ( void )
-{}
+// the map members in Material::Map order
+static std::string OBJ::Material::*const MATERIAL_MAPS[OBJ::Material::MAP_COUNT] = {
+	&OBJ::Material::ambientMap,
+	&OBJ::Material::diffuseMap,
+	&OBJ::Material::specularMap,
+	&OBJ::Material::emissiveMap,
+	&OBJ::Material::transmissionMap,
+	&OBJ::Material::shininessMap,
+	&OBJ::Material::alphaMap,
+	&OBJ::Material::dissolveMap,
+	&OBJ::Material::displacementMap,
+	&OBJ::Material::detailMap,
+	&OBJ::Material::bumpMap
+};
 
-bool OBJ::Open(File &file, const std::string &filename)
+const std::string &OBJ::Material::GetMap(Map map) const
 {
-	file.fin.open(filename.c_str());
-	if (file.fin.is_open()) {
-		file.name = filename;
-		file.lineNo = 0;
-		return true;
-	}
-	warnings.push_back("Could not open \"" + filename + "\"");
-	return false;
+	return this->*MATERIAL_MAPS[map];
 }
 
-void OBJ::ReadLine(File &file) const
+bool OBJ::Span::operator==(const char *str) const
 {
-	file.type.clear();
-	file.params.clear();
+	const size_t len = strlen(str);
+	return len == size() && memcmp(begin, str, len) == 0;
+}
 
-	std::string line;
-	std::getline(file.fin, line);
-	++file.lineNo;
-	std::istringstream sin(line);
-	sin >> file.type;
-	std::getline(sin, file.params);
+bool OBJ::Span::operator==(const std::string &str) const
+{
+	return str.size() == size() && memcmp(begin, str.data(), size()) == 0;
 }
 
-void OBJ::AddError(const File &file, std::ostringstream &sout)
+// keywords are looked up by switching on their first character followed by
+// at most a few comparisons, so the cost is the same for every keyword
+OBJ::ObjKeyword OBJ::GetObjKeyword(const Span &type)
 {
-	std::string errorInfo = sout.str();
-	sout.str("");
-	sout << file.name << ": Line " << file.lineNo << ": ";
-	errors.push_back(sout.str() + errorInfo);
-	sout.str("");
+	if (type.empty() || type[0] == '#') { return OBJ_NONE; }
+	switch (type[0]) {
+		case 'v':
+			if (type.size() == 1) { return OBJ_v; }
+			if (type.size() == 2) {
+				switch (type[1]) {
+					case 't': return OBJ_vt;
+					case 'n': return OBJ_vn;
+					case 'p': return OBJ_vp;
+				}
+			}
+			break;
+		case 'f':
+			if (type.size() == 1) { return OBJ_f; }
+			break;
+		case 'g':
+			if (type.size() == 1) { return OBJ_g; }
+			break;
+		case 'o':
+			if (type.size() == 1) { return OBJ_o; }
+			break;
+		case 'p':
+			if (type.size() == 1) { return OBJ_p; }
+			if (type == "parm") { return OBJ_parm; }
+			break;
+		case 'l':
+			if (type.size() == 1) { return OBJ_l; }
+			if (type == "lod") { return OBJ_lod; }
+			break;
+		case 's':
+			if (type.size() == 1) { return OBJ_s; }
+			if (type == "sp") { return OBJ_sp; }
+			if (type == "step") { return OBJ_step; }
+			if (type == "surf") { return OBJ_surf; }
+			if (type == "scrv") { return OBJ_scrv; }
+			if (type == "stech") { return OBJ_stech; }
+			if (type == "shadow_obj") { return OBJ_shadow_obj; }
+			break;
+		case 'u':
+			if (type == "usemtl") { return OBJ_usemtl; }
+			if (type == "usemap") { return OBJ_usemap; }
+			break;
+		case 'm':
+			if (type == "mg") { return OBJ_mg; }
+			if (type == "mtllib") { return OBJ_mtllib; }
+			if (type == "maplib") { return OBJ_maplib; }
+			break;
+		case 'c':
+			if (type == "con") { return OBJ_con; }
+			if (type == "curv") { return OBJ_curv; }
+			if (type == "curv2") { return OBJ_curv2; }
+			if (type == "ctech") { return OBJ_ctech; }
+			if (type == "cstype") { return OBJ_cstype; }
+			if (type == "c_interp") { return OBJ_c_interp; }
+			break;
+		case 'd':
+			if (type == "deg") { return OBJ_deg; }
+			if (type == "d_interp") { return OBJ_d_interp; }
+			break;
+		case 'b':
+			if (type == "bmat") { return OBJ_bmat; }
+			if (type == "bevel") { return OBJ_bevel; }
+			break;
+		case 't':
+			if (type == "trim") { return OBJ_trim; }
+			if (type == "trace_obj") { return OBJ_trace_obj; }
+			break;
+		case 'h':
+			if (type == "hole") { return OBJ_hole; }
+			break;
+		case 'e':
+			if (type == "end") { return OBJ_end; }
+			break;
+	}
+	return OBJ_UNKNOWN;
 }
 
-void OBJ::AddWarning(const File &file, std::ostringstream &sout)
+OBJ::LoadStats::Phase OBJ::GetParsePhase(ObjKeyword keyword)
 {
-	std::string errorInfo = sout.str();
-	sout.str("");
-	sout << file.name << ": Line " << file.lineNo << ": ";
-	warnings.push_back(sout.str() + errorInfo);
-	sout.str("");
+	switch (keyword) {
+		case OBJ_v:
+		case OBJ_vt:
+		case OBJ_vn:
+			return LoadStats::PARSE_VERTICES;
+		case OBJ_f:
+			return LoadStats::PARSE_FACES;
+		default:
+			return LoadStats::PARSE_OTHER;
+	}
 }
 
-// http://paulbourke.net/dataformats/obj/
-// http://www.fileformat.info/format/material/
-// To do:
-// No full support for .MTL files. See documentation.
-// HOW ARE MATERIALS ASSIGNED TO A SINGLE VERTEX INSTEAD OF A FACE? (c_interp)
-// Add support for line continuation using "\" as token.
-// Error handling for "name", "g" and "shadowModel" (shadowModel may only take one file)
-// BUG: "mtllib" and "map_Ka" "shadowModel" do not handle paths with spaces properly. Add support for "-token.
-// Remove the possibility to input several filenames in mtllib, map_Ka et al. Not necessary.
-// For every LOD all materials need to be reread and restored, even if it has it in common with other LOD:s
-OBJ::OBJ(const std::string &filename) :
-	fileName(filename),
-	name(),
-	shadowModel(),
-	levelOfDetail(),
-	materials()
+// unknown keywords are counted by name in ReadObjLine
+void OBJ::AddLineCounts(const size_t *lineCount, LoadStats &stats)
 {
-	static const int OBJ_NUM_KEYWORDS = 37;
-	static const std::string OBJ_KEYWORDS[OBJ_NUM_KEYWORDS] = {
-		"v", // supported
-		"vt", // supported
-		"vn", // supported
-		"f", // supported
-		"o", // supported
-		"vp",
-		"deg", // implement?
-		"bmat", // implement?
-		"step",
-		"cstype",
-		"p",
-		"l",
-		"curv",
-		"curv2",
-		"surf",
-		"parm",
-		"trim",
-		"hole",
-		"scrv",
-		"sp",
-		"end",
-		"con",
-		"g", // supported
-		"s",
-		"mg",
-		"bevel",
-		"c_interp",
-		"d_interp",
-		"lod", // supported
-		"usemtl", // supported
-		"mtllib", // supported
-		"shadow_obj", // supported
-		"trace_obj",
-		"ctech",
-		"stech",
-		"maplib",
-		"usemap"
+	static const char *const KEYWORD_NAMES[] = {
+		"#", NULL, "v", "vt", "vn", "f", "o", "vp", "deg", "bmat", "step", "cstype", "p", "l", "curv", "curv2",
+		"surf", "parm", "trim", "hole", "scrv", "sp", "end", "con", "g", "s", "mg", "bevel", "c_interp", "d_interp",
+		"lod", "usemtl", "mtllib", "shadow_obj", "trace_obj", "ctech", "stech", "maplib", "usemap"
 	};
-
-	// generate the working directory so that calls to 'mtllib' can be relative to the .obj file instead of the executable.
-	size_t lastDirectory = std::string::npos;
-	const size_t lastForwardSlash = filename.find_last_of('/');
-	if (lastForwardSlash != std::string::npos) { lastDirectory = lastForwardSlash; }
-	const size_t lastBackslash = filename.find_last_of('\\');
-	if (lastBackslash != std::string::npos) {
-		if (lastForwardSlash == std::string::npos) {
-			lastDirectory = lastForwardSlash;
-		} else {
-			lastDirectory = (lastForwardSlash > lastBackslash) ? lastForwardSlash : lastBackslash;
+	static_assert(sizeof(KEYWORD_NAMES) / sizeof(KEYWORD_NAMES[0]) == OBJ_KEYWORD_COUNT, "a keyword is missing a name");
+	for (int i = 0; i < OBJ_KEYWORD_COUNT; ++i) {
+		if (lineCount[i] > 0 && KEYWORD_NAMES[i] != NULL) {
+			stats.lines[KEYWORD_NAMES[i]] += lineCount[i];
 		}
 	}
-	std::string workingDirectory = "";
-	if (lastDirectory != std::string::npos) {
-		workingDirectory = filename.substr(0, lastDirectory + 1);
-	}
+}
 
-	StateVariables state;
-	levelOfDetail.push_back(OBJ::LevelOfDetail());
-	state.LOD = levelOfDetail.begin();
-	state.LOD->groups.push_back(OBJ::Group());
-	state.groups.push_back(state.LOD->groups.begin());
-	materials.push_back(OBJ::Material()); // a default material
-	state.material = materials.begin();
-	
-	std::ostringstream sout; // for concatenating error/warning strings
-	File objFile; // handles the input stream from the file
+OBJ::MtlKeyword OBJ::GetMtlKeyword(const Span &type)
+{
+	if (type.empty() || type[0] == '#') { return MTL_NONE; }
+	switch (type[0]) {
+		case 'K':
+			if (type.size() == 2) {
+				switch (type[1]) {
+					case 'a': return MTL_Ka;
+					case 'd': return MTL_Kd;
+					case 's': return MTL_Ks;
+					case 'e': return MTL_Ke;
+				}
+			}
+			break;
+		case 'T':
+			if (type.size() == 2) {
+				switch (type[1]) {
+					case 'r': return MTL_Tr;
+					case 'f': return MTL_Tf;
+				}
+			}
+			break;
+		case 'N':
+			if (type.size() == 2) {
+				switch (type[1]) {
+					case 's': return MTL_Ns;
+					case 'i': return MTL_Ni;
+				}
+			}
+			break;
+		case 'd':
+			if (type.size() == 1) { return MTL_d; }
+			if (type == "disp") { return MTL_disp; }
+			if (type == "decal") { return MTL_decal; }
+			break;
+		case 'n':
+			if (type == "newmtl") { return MTL_newmtl; }
+			break;
+		case 's':
+			if (type == "sharpness") { return MTL_sharpness; }
+			break;
+		case 'i':
+			if (type == "illum") { return MTL_illum; }
+			break;
+		case 'b':
+			if (type == "bump") { return MTL_bump; }
+			break;
+		case 'm':
+			if (type.size() > 4 && memcmp(type.begin, "map_", 4) == 0) {
+				const Span map(type.begin + 4, type.end);
+				if (map == "Ka") { return MTL_map_Ka; }
+				if (map == "Kd") { return MTL_map_Kd; }
+				if (map == "Ks") { return MTL_map_Ks; }
+				if (map == "Ke") { return MTL_map_Ke; }
+				if (map == "Tf") { return MTL_map_Tf; }
+				if (map == "Ns") { return MTL_map_Ns; }
+				if (map == "Tr") { return MTL_map_Tr; }
+				if (map == "d") { return MTL_map_d; }
+			}
+			break;
+	}
+	return MTL_UNKNOWN;
+}
 
-	if (Open(objFile, filename)) {
+OBJ::File::~File( void )
+{
+#ifdef OBJ_USE_MMAP
+	if (mapBegin != mapEnd) { // empty files are not mapped
+		munmap((void*)mapBegin, (size_t)(mapEnd - mapBegin));
+	}
+#endif
+}
 
-		fileName = filename;
+OBJ::OBJ( void )
+{}
 
-		while (!objFile.fin.eof()) {
+static inline bool IsBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
 
-			ReadLine(objFile);
+static inline bool IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
 
-			if (objFile.type == "o") {
-				// read object name
-				// must be a name without spaces
-				name = objFile.params; // read this straight to the main object
-			} else if (objFile.type == "v") {
-				// read vertex position
-				// fourth parameter is optional
-				state.LOD->vertices.push_back(float4());
-				ReadParams(objFile, 3, 4, 1.0f, (float*)state.LOD->vertices.back());
-			} else if (objFile.type == "vt") {
-				// read texture coordinates
-				// second and third parameters are optional
-				state.LOD->texCoords.push_back(float3());
-				ReadParams(objFile, 1, 3, 0.0f, (float*)state.LOD->texCoords.back());
-			} else if (objFile.type == "vn") {
-				// read vertex normals
-				// no optional parameters
-				// normals need not be of unit length
-				state.LOD->normals.push_back(float3());
-				ReadParams(objFile, 3, (float*)state.LOD->normals.back());
-			} else if (objFile.type == "f") {
-				// read face definitions
-				// face definitions can contain any number of vertex indices
-				// indices are numbered 1 - n, not 0 - n-1, but are converted to 0 - n-1 (where -1 means "no index")
-				// for simplicity; store faces > 3 as a fan of triangles
-				std::list<std::string> vert;
-				ReadVariableParams(objFile, Step_f_idx_elem, vert);
-				std::vector<int> face; // intermediate for storing the current face
-				for (std::list<std::string>::const_iterator vertex = vert.begin(); vertex != vert.end(); ++vertex) {
-					size_t currentPos = 0;
-					int i;
-					for (i = 0; i < Step_f_idx_elem && currentPos != std::string::npos; ++i) { // parse v, v/vt, v/vt/vn, v//vn
-						size_t searchFrom = currentPos + (i != 0);
-						face.push_back( atoi(vertex->substr(searchFrom, vertex->find("/", searchFrom) - searchFrom).c_str()) - 1 );
-						currentPos = vertex->find("/", searchFrom);
-					}
-					switch (i) { // adds missing elements if they where omitted from the .obj file (-1 is invalid value)
-						case 1:
-							face.push_back(-1);
-						case 2:
-							face.push_back(-1);
-					};
-					
-					if (face[face.size()-3] < -1) { // < -1 indicates relative indexing (< -2 is represented < -1 in the file)
-						const int relative = face[face.size()-3]+1;
-						const int size = (int)state.LOD->vertices.size();
-						const int absolute = size + relative;
-						if (absolute < 0) {
-							sout << "Relative index " << relative << " is out of defined range for \'v\' (size is " << size << ")";
-							AddError(objFile, sout);
-						} else {
-							face[face.size()-3] = absolute;
-						}
-					}
-					if (face[face.size()-2] < -1) {
-						const int relative = face[face.size()-2]+1;
-						const int size = (int)state.LOD->texCoords.size();
-						const int absolute = size + relative;
-						if (absolute < 0) {
-							sout << "Relative index " << relative << " is out of defined range for \'vt\' (size is " << size << ")";
-							AddError(objFile, sout);
-						} else {
-							face[face.size()-2] = absolute;
-						}
-					}
-					if (face[face.size()-1] < -1) {
-						const int relative = face[face.size()-1]+1;
-						const int size = (int)state.LOD->normals.size();
-						const int absolute = size + relative;
-						if (absolute < 0) {
-							sout << "Relative index " << relative << " is out of defined range for \'vn\' (size is " << size << ")";
-							AddError(objFile, sout);
-						} else {
-							face[face.size()-1] = absolute;
-						}
-					}
-					
-					
-					if (currentPos != std::string::npos) { // if this is true, then the parsing loop has broken at 3, yet there was more info to parse, meaning the .obj file is syntactically wrong.
-						sout << "Syntax error (f v, f v/vt, f v/vt/vn, f v//vn)";
-						AddError(objFile, sout);
-					}
-					if (face[face.size()-3] >= ((int)state.LOD->vertices.size())) {
-						sout << "Index " << face[face.size()-3]+1 << " is out of defined range for \'v\'";
-						AddError(objFile, sout);
-					}
-					if (face[face.size()-2] >= ((int)state.LOD->texCoords.size())) {
-						sout << "Index " << face[face.size()-2]+1 << " is out of defined range for \'vt\'";
-						AddError(objFile, sout);
-					}
-					if (face[face.size()-1] >= ((int)state.LOD->normals.size())) {
-						sout << "Index " << face[face.size()-1]+1 << " is out of defined range for \'vn\'";
-						AddError(objFile, sout);
-					}
-				}
-				if (face.size()%Step_f_idx_elem != 0) { // sanity check, makes sure that every vertex index has three elements (v/vn/vt)
-					sout << "Parsing code bug";
-					AddError(objFile, sout);
-				} else if (face.size() >= Step_f) {
-					int numUnavailable = 0;
-					size_t i;
-					for (i = 0; i < Step_f_idx; ++i) {
-						for (size_t j = i; j < face.size(); j+=Step_f_idx) { // count the number of omitted elements in the vertex index...
-							if (face[j] == -1) { ++numUnavailable; }
-						}
-						if (numUnavailable % (face.size()/Step_f_idx) != 0) { // ...must be a multiple of the number of specified vertex indices
-							// remember, this is /before/ the face definition is converted to a set of triangles, so omitted elements can be a non-multiple of 3 and still be valid.
-							sout << "Vertex index mismatch";
-							AddError(objFile, sout);
-							break;
-						}
-					}
-					if (i == Step_f_idx) { // or else error occurred
-						// convert the face into a triangle fan
-						// NOTE: if triangles are facing the wrong way, swap the order the elements are pushed
-						for (size_t i=(size_t)Step_f_idx; i < face.size()-(size_t)Step_f_idx; i+=Step_f_idx) { // numParam has guaranteed that face.size() is at least 3
-							
-							state.LOD->facets.push_back(OBJ::Facet());
-							OBJ::Facet &facet = state.LOD->facets.back();
-							// vertex 1
-							facet.vertex[0] = face[IndexPos];
-							facet.texCoord[0] = face[IndexTex];
-							facet.normal[0] = face[IndexNor];
-							// vertex 2
-							facet.vertex[1] = face[i+IndexPos];
-							facet.texCoord[1] = face[i+IndexTex];
-							facet.normal[1] = face[i+IndexNor];
-							//vertex 3
-							facet.vertex[2] = face[i+Step_f_idx+IndexPos];
-							facet.texCoord[2] = face[i+Step_f_idx+IndexTex];
-							facet.normal[2] = face[i+Step_f_idx+IndexNor];
-							// material
-							facet.material = state.materialIndex;
-							// group
-							for (std::list<GroupList::iterator>::iterator it = state.groups.begin(); it != state.groups.end(); ++it) {
-								(*it)->facets.push_back(state.LOD->facets.size() - 1);
-							}
-						}
-					}
-				}
-			} else if (objFile.type == "g") { // faces can belong to multiple groups
-				
-				// read parameters
-				std::list<std::string> groupNames;
-				ReadVariableParams(objFile, 1, groupNames);
-				
-				// find groups and construct a group list that all succeeding facets are part of
-				state.groups.clear();
-				for (std::list<std::string>::iterator gn = groupNames.begin(); gn != groupNames.end(); ++gn) {
-					GroupList::iterator gi;
-					for (gi = state.LOD->groups.begin(); gi != state.LOD->groups.end(); ++gi) {
-						if (gi->name == *gn) { // the group already exists
-							state.groups.push_back(gi);
-							break;
-						}
-					}
-					if (gi == state.LOD->groups.end()) { // the group does not exist, create new group
-						Group newGroup;
-						newGroup.name = *gn;
-						state.LOD->groups.push_back(newGroup);
-						state.groups.push_back(--gi);
-					}
-				}
-			} else if (objFile.type == "usemtl") {
-				MaterialList::const_iterator material = materials.begin();
-				for (int i = 0; material != materials.end(); ++i, ++material) {
-					if (material->name == objFile.params) {
-						state.materialIndex = i;
-						break;
-					}
-				}
-				if (material == materials.end()) {
-					sout << "Material \"" << objFile.params << "\" not defined";
-					AddError(objFile, sout);
-					state.materialIndex = OBJ::Facet::DEFAULT_MATERIAL;
-				}
-			}  else if (objFile.type == "mtllib") {
-				File mtlFile;
+// The numeric readers below replace std::istream::operator>> for parameters.
+// They do not allocate and do not depend on the current locale (the decimal
+// separator is always '.'). A value must be followed by a blank or the end
+// of the line, otherwise it is not considered a value at all.
+bool OBJ::ReadValue(const char *&in, const char *end, float &out)
+{
+	static const double POW10[] = {
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	static const int MAX_EXACT_POW10 = 22;
+	static const unsigned long long MANTISSA_LIMIT = 1000000000000000000ULL; // more digits than that do not affect a float
 
-				//
-				// NOTE
-				//
-				// Each mtllib statement can contain
-				// more than one filename. This is
-				// currently not supported.
-				//
+	while (in < end && IsBlank(*in)) { ++in; }
+	const char *p = in;
 
-				if (Open(mtlFile, workingDirectory + objFile.params)) {
-					//
-					// Note
-					//
-					// All of the keywords are supported,
-					// albeit not fully. Keywords within
-					// the keywords are not supported at
-					// all.
-					//
-					static const int MTL_NUM_KEYWORDS = 20;
-					static const std::string MTL_KEYWORDS[MTL_NUM_KEYWORDS] = {
-						"newmtl", // supported
-						"Ka", // supported
-						"Kd", // supported
-						"Ks", // supported
-						"Ke", // supported
-						"Tr", // supported
-						"d", // supported
-						"Tf", // supported
-						"Ns", // supported
-						"Ni", // supported
-						"sharpness", // supported
-						"illum", // supported
-						"map_Ka", // supported
-						"map_Kd", // supported
-						"map_Ks", // supported
-						"map_Ke", // supported
-						"map_Tf", // supported
-						"disp", // supported
-						"decal", // supported
-						"bump" // supported
-					};
-					
-					state.material = materials.end();
-					state.materialIndex = materials.size() - 1;
-
-					while (!mtlFile.fin.eof()) {
-						ReadLine(mtlFile);
-
-						if (mtlFile.type == "newmtl") {
-							std::string materialName;
-							if (!mtlFile.params.empty()) {
-								materialName = mtlFile.params;
-							}
-
-							if (materialName.find(" ") != std::string::npos || materialName.find("\t") != std::string::npos) {
-								sout << "Material name may not include blank characters: see \"" << materialName << "\"";
-								AddError(mtlFile, sout);
-								state.material = materials.end(); // if material name failed mtl is set to invalid value
-								state.materialIndex = -1;
-							} else { // name is OK
-								for (state.material = materials.begin(); state.material != materials.end(); ++state.material) {
-									if (materialName == state.material->name) {
-										break;
-									}
-								}
-								if (state.material == materials.end()) { // if you get here, then material name passed all error checks
-									materials.push_back(OBJ::Material()); // automatically sets up defaults
-									state.material = materials.end();
-									--state.material;
-									state.materialIndex = materials.size() - 1;
-									state.material->name = materialName;
-								} else {
-									sout << "Redefinition of material \"" << state.material->name << "\"";
-									AddError(mtlFile, sout);
-									state.material = materials.end(); // set mtl to invalid value
-									state.materialIndex = -1;
-								}
-							}
-						} else if (state.material != materials.end()) {
-							//
-							// Note
-							//
-							// Ka, Kd, Ks et al. are not implemented correctly.
-							// Read their values as strings, not as floats, since
-							// parameters can contain keywords such as "spectral".
-							//
-							if (mtlFile.type == "Ka") { // ambient color
-								ReadParams(mtlFile, 3, (float*)state.material->ambient);
-							} else if (mtlFile.type == "Kd") { // diffuse color
-								ReadParams(mtlFile, 3, (float*)state.material->diffuse);
-							} else if (mtlFile.type == "Ks") { // specular color
-								ReadParams(mtlFile, 3, (float*)state.material->specular);
-							} else if (mtlFile.type == "Ke") { // emissive color
-								ReadParams(mtlFile, 3, (float*)state.material->emissive);
-							} else if (mtlFile.type == "Tr") { // alpha
-								ReadParams(mtlFile, 1, &state.material->alpha);
-							} else if (mtlFile.type == "d") { // dissolve (same as alpha?)
-								ReadParams(mtlFile, 1, &state.material->dissolve);
-							} else if (mtlFile.type == "Tf") { // transmission filter
-								ReadParams(mtlFile, 3, (float*)state.material->transmission);
-							} else if (mtlFile.type == "Ns") { // shininess
-								ReadParams(mtlFile, 1, &state.material->shininess);
-							} else if (mtlFile.type == "Ni") { // optical density
-								ReadParams(mtlFile, 1, &state.material->opticalDensity);
-							} else if (mtlFile.type == "sharpness") { // sharpness
-								ReadParams(mtlFile, 1, &state.material->sharpness);
-							} else if (mtlFile.type == "illum") { // illumination
-								ReadParams(mtlFile, 1, &state.material->illumination);
-								int illum = state.material->illumination;
-								if (illum != OBJ::Material::FLAT && illum != OBJ::Material::DIFFUSE && illum != OBJ::Material::DIFFUSE_AND_SPECULAR) {
-									sout << "\'" << mtlFile.type << "\' is not set to a recognisable shader model (only flat (0), diffuse (1), diffuse + specular (2)).";
-									AddWarning(mtlFile, sout);
-								}
-							}
-							//
-							// NOTE
-							//
-							// map_Kx can contain more information than just
-							// a file name. This is currently not supported.
-							//
-							else if (mtlFile.type == "map_Ka") {
-								File mapFile;
-								if (Open(mapFile, workingDirectory + mtlFile.params)) {
-									state.material->ambientMap = mapFile.name;
-								}
-							} else if (mtlFile.type == "map_Kd") {
-								File mapFile;
-								if (Open(mapFile, workingDirectory + mtlFile.params)) {
-									state.material->diffuseMap = mapFile.name;
-								}
-							} else if (mtlFile.type == "map_Ks") {
-								File mapFile;
-								if (Open(mapFile, workingDirectory + mtlFile.params)) {
-									state.material->specularMap = mapFile.name;
-								}
-							} else if (mtlFile.type == "map_Ke") {
-								File mapFile;
-								if (Open(mapFile, workingDirectory + mtlFile.params)) {
-									state.material->emissiveMap = mapFile.name;
-								}
-							} else if (mtlFile.type == "map_Tf") {
-								File mapFile;
-								if (Open(mapFile, workingDirectory + mtlFile.params)) {
-									state.material->transmissionMap = mapFile.name;
-								}
-							} else if (mtlFile.type == "map_Ns") {
-								File mapFile;
-								if (Open(mapFile, workingDirectory + mtlFile.params)) {
-									state.material->shininessMap = mapFile.name;
-								}
-							} else if (mtlFile.type == "map_Tr") {
-								File mapFile;
-								if (Open(mapFile, workingDirectory + mtlFile.params)) {
-									state.material->alphaMap = mapFile.name;
-								}
-							} else if (mtlFile.type == "map_d") {
-								File mapFile;
-								if (Open(mapFile, workingDirectory + mtlFile.params)) {
-									state.material->dissolveMap = mapFile.name;
-								}
-							} else if (mtlFile.type == "disp") {
-								File mapFile;
-								if (Open(mapFile, workingDirectory + mtlFile.params)) {
-									state.material->displacementMap = mapFile.name;
-								}
-							} else if (mtlFile.type == "decal") {
-								File mapFile;
-								if (Open(mapFile, workingDirectory + mtlFile.params)) {
-									state.material->detailMap = mapFile.name;
-								}
-							} else if (mtlFile.type == "bump") {
-								File mapFile;
-								if (Open(mapFile, workingDirectory + mtlFile.params)) {
-									state.material->bumpMap = mapFile.name;
-								}
-							} else if (mtlFile.type.size() > 0 && mtlFile.type[0] != '#') {
-								int i = 0;
-								for (; i < MTL_NUM_KEYWORDS; ++i) {
-									if (mtlFile.type == MTL_KEYWORDS[i]) { break; }
-								}
-								if (i < MTL_NUM_KEYWORDS) { // output warning if keyword is valid, but not supported
-									sout << " \'" << MTL_KEYWORDS[i] << "\' is not supported at this time";
-									AddWarning(mtlFile, sout);
-								} else {
-									sout << " Unknown type \'" << mtlFile.type << "\'";
-									AddError(mtlFile, sout);
-								}
-							}
-						} else if (mtlFile.type.size() > 0 && mtlFile.type[0] != '#') {
-							int i = 0;
-							for (; i < MTL_NUM_KEYWORDS; ++i) {
-								if (mtlFile.type == MTL_KEYWORDS[i]) { break; }
-							}
-							if (i < MTL_NUM_KEYWORDS) { // output warning if keyword is valid, but not supported
-								sout << "\'" << mtlFile.type << "\' operating on undefined material";
-								AddError(mtlFile, sout);
-							} else {
-								sout << " Unknown type \'" << mtlFile.type << "\'";
-								AddError(mtlFile, sout);
-							}
-						}
-					}
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		++p;
+	}
 
-				} else {
-					sout << "Specified files could not be opened";
-					AddError(objFile, sout);
-				}
-			} else if (objFile.type == "shadow_obj") {
-				// According to the standard, there can be only one
-				// shadow object per .obj file (not one for each LOD).
-				// Only the last specified shadow_obj filename is relevant.
-				shadowModel = objFile.params;
-			} else if (objFile.type == "lod") {
-				int lodVal;
-				ReadParams(objFile, 1, &lodVal);
-				if (state.LOD->facets.size() == 0) { // LOD does not contain any relevant data
-					sout << "Previous LOD " << state.LOD->levelOfDetail << " does not contain any relevant data. Skipping...";
-					AddWarning(objFile, sout);
-					levelOfDetail.erase(state.LOD);
-				}
-				for (state.LOD = levelOfDetail.begin(); state.LOD != levelOfDetail.end(); ++state.LOD) {
-					if (lodVal >= state.LOD->levelOfDetail) {
-						break;
-					}
-				}
-				state.LOD = levelOfDetail.insert(state.LOD, OBJ::LevelOfDetail());
-			} else if (!objFile.type.empty() && objFile.type[0] != '#') {
-				int i = 0;
-				for (; i < OBJ_NUM_KEYWORDS; ++i) {
-					if (objFile.type == OBJ_KEYWORDS[i]) { break; }
-				}
-				if (i < OBJ_NUM_KEYWORDS) { // output warning if keyword is valid, but not supported
-					sout << " \'" << OBJ_KEYWORDS[i] << "\' is not supported at this time";
-					AddWarning(objFile, sout);
-				} else {
-					sout << " Unknown type \'" << objFile.type << "\'";
-					AddError(objFile, sout);
-				}
+	unsigned long long mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	for (; p < end && IsDigit(*p); ++p, ++digits) {
+		if (mantissa < MANTISSA_LIMIT) {
+			mantissa = mantissa * 10 + (unsigned long long)(*p - '0');
+		} else {
+			++exponent;
+		}
+	}
+	if (p < end && *p == '.') {
+		for (++p; p < end && IsDigit(*p); ++p, ++digits) {
+			if (mantissa < MANTISSA_LIMIT) {
+				mantissa = mantissa * 10 + (unsigned long long)(*p - '0');
+				--exponent;
 			}
 		}
-		if (state.LOD->facets.size() == 0) {
-			sout << "File does not contain any face definitions";
-			warnings.push_back(sout.str());
-			sout.str("");
+	}
+	if (digits == 0) { return false; }
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		++p;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negativeExponent = (*p == '-');
+			++p;
+		}
+		if (p == end || !IsDigit(*p)) { return false; }
+		int e = 0;
+		for (; p < end && IsDigit(*p); ++p) {
+			if (e < 10000) { e = e * 10 + (*p - '0'); }
+		}
+		exponent += negativeExponent ? -e : e;
+	}
+	if (p < end && !IsBlank(*p)) { return false; }
+
+	double value = (double)mantissa;
+	if (mantissa != 0 && exponent != 0) {
+		if (exponent > 0 && exponent <= MAX_EXACT_POW10) {
+			value *= POW10[exponent];
+		} else if (exponent < 0 && exponent >= -MAX_EXACT_POW10) {
+			value /= POW10[-exponent];
+		} else {
+			value *= pow(10.0, exponent);
 		}
-	} else {
-		sout << "\"" << objFile.name << "\": File could not be opened";
-		errors.push_back(sout.str());
-		sout.str("");
 	}
+	out = (float)(negative ? -value : value);
+	in = p;
+	return true;
 }
 
-OBJ::Status OBJ::GetStatus( void ) const
+bool OBJ::ReadValue(const char *&in, const char *end, int &out)
 {
-	if (!errors.empty()) {
-		return OBJ::ERRORS;
-	} else if (!warnings.empty()) {
-		return OBJ::WARNINGS;
+	while (in < end && IsBlank(*in)) { ++in; }
+	const char *p = in;
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		++p;
 	}
-	return OBJ::OK;
+	if (p == end || !IsDigit(*p)) { return false; }
+
+	long long value = 0;
+	for (; p < end && IsDigit(*p); ++p) {
+		value = value * 10 + (*p - '0');
+		if (value > 2147483648LL) { return false; } // does not fit in an int
+	}
+	if (p < end && !IsBlank(*p)) { return false; }
+	if (negative) { value = -value; }
+	if (value > 2147483647LL) { return false; }
+
+	out = (int)value;
+	in = p;
+	return true;
 }
 
-void OBJ::Reverse( void )
+bool OBJ::ReadValue(const char *&in, const char *end, std::string &out)
 {
-	// models are made for looking down the negative z axis
-	// engine looks down the positive z axis
-	// 1. reverse triangle winding order
-	// 2. negate model's z coordinates (will this muck with winding order, i.e. do I need to change BOTH winding order and z coordinates - if no, change z coordinates)
-	// 3. negate model's normals' z coordinates
-	for (LODList::iterator lod = levelOfDetail.begin(); lod != levelOfDetail.end(); ++lod) {
-		// Swap triangle winding order
-		for (FacetList::iterator facet = lod->facets.begin(); facet != lod->facets.end(); ++facet) {
-			Swap(facet->vertex[0], facet->vertex[2]);
-			Swap(facet->texCoord[0], facet->texCoord[2]);
-			Swap(facet->normal[0], facet->normal[2]);
+	while (in < end && IsBlank(*in)) { ++in; }
+	const char *p = in;
+	while (p < end && !IsBlank(*p)) { ++p; }
+	if (p == in) { return false; }
+	out.assign(in, p);
+	in = p;
+	return true;
+}
+
+// reads a single (possibly relative) index of a face vertex, i.e. the part between slashes
+static inline bool ReadIndex(const char *&in, const char *end, int &out)
+{
+	const char *p = in;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		++p;
+	}
+	if (p == end || !IsDigit(*p)) { return false; }
+	long long value = 0;
+	for (; p < end && IsDigit(*p); ++p) {
+		value = value * 10 + (*p - '0');
+		if (value > 2147483647LL) { return false; } // does not fit in an int (also once converted to 0 - n-1)
+	}
+	out = (int)(negative ? -value : value);
+	in = p;
+	return true;
+}
+
+// decodes a single vertex of a face (v, v/vt, v/vt/vn, v//vn) starting at a non-blank character
+// indices are converted to 0 - n-1 (where -1 means "no index"), relative indices are left unresolved
+// returns false on syntax errors, in which case the rest of the vertex is skipped
+static bool DecodeFaceVertex(const char *&in, const char *end, int *index)
+{
+	int i = 0;
+	bool syntaxError = false;
+	while (true) {
+		int value = 0; // omitted elements become -1 below
+		if (!ReadIndex(in, end, value) && in < end && *in != '/' && !IsBlank(*in)) {
+			syntaxError = true;
+		}
+		index[i++] = value - 1;
+		if (syntaxError || in == end || *in != '/') { break; }
+		++in;
+		if (i == 3) { // there was more info to parse, meaning the .obj file is syntactically wrong
+			syntaxError = true;
+			break;
 		}
-		// Invert Z axis
-		for (VertexList::iterator vertex = lod->vertices.begin(); vertex != lod->vertices.end(); ++vertex) {
-			(*vertex)[Z] = -(*vertex)[Z];
+	}
+	for (; i < 3; ++i) { // adds missing elements if they where omitted from the .obj file (-1 is invalid value)
+		index[i] = -1;
+	}
+	if (syntaxError) {
+		while (in < end && !IsBlank(*in)) { ++in; }
+	}
+	return !syntaxError;
+}
+
+// resolves relative indices of a decoded face vertex against the number of elements defined so far
+void OBJ::ResolveFaceVertex(const File &file, const int *size, int *index)
+{
+	static const char *ELEMENT_NAME[Step_f_idx_elem] = { "v", "vt", "vn" };
+	for (int i = 0; i < Step_f_idx_elem; ++i) {
+		if (index[i] < -1) { // < -1 indicates relative indexing (< -2 is represented < -1 in the file)
+			const int relative = index[i] + 1;
+			const int absolute = size[i] + relative;
+			if (absolute < 0) {
+				std::ostringstream sout;
+				sout << "Relative index " << relative << " is out of defined range for \'" << ELEMENT_NAME[i] << "\' (size is " << size[i] << ")";
+				AddError(file, sout);
+			} else {
+				index[i] = absolute;
+			}
 		}
-		// Invert normals
-		for (NormalList::iterator normal = lod->normals.begin(); normal != lod->normals.end(); ++normal) {
-			(*normal)[X] = -(*normal)[X];
-			(*normal)[Y] = -(*normal)[Y];
-			(*normal)[Z] = -(*normal)[Z];
+		if (index[i] >= size[i]) {
+			std::ostringstream sout;
+			sout << "Index " << index[i]+1 << " is out of defined range for \'" << ELEMENT_NAME[i] << "\'";
+			AddError(file, sout);
 		}
 	}
 }
 
-void OBJ::DumpErrors(std::ostream &out, const unsigned int MaxErrors) const
+// parses the parameters of an "f" line in a single pass
+// indices are stored as v,vt,vn triplets (see DecodeFaceVertex)
+bool OBJ::ReadFace(const File &file, int numVertices, int numTexCoords, int numNormals, std::vector<int> &face)
 {
-	size_t n = 0;
-	for (std::list<std::string>::const_iterator i = errors.begin(); i != errors.end(); ++i){
-		out << *i << std::endl;
-		if (++n == MaxErrors) {
-			out << "<< " << errors.size() - n << " more error(s) >>" << std::endl;
-			break;
+	const int size[Step_f_idx_elem] = { numVertices, numTexCoords, numNormals };
+
+	face.clear();
+	const char *in = file.params.begin;
+	const char *end = file.params.end;
+	int numParams = 0;
+	while (true) {
+		while (in < end && IsBlank(*in)) { ++in; }
+		if (in == end) { break; }
+
+		int index[Step_f_idx_elem];
+		if (!DecodeFaceVertex(in, end, index)) {
+			std::ostringstream sout;
+			sout << "Syntax error (f v, f v/vt, f v/vt/vn, f v//vn)";
+			AddError(file, sout);
 		}
+		++numParams;
+		ResolveFaceVertex(file, size, index);
+		face.insert(face.end(), index, index + Step_f_idx_elem);
 	}
-	out << "--" << errors.size() << " error(s)--" << std::endl;
+
+	if (numParams < Step_f_idx_elem) {
+		std::ostringstream sout;
+		sout << "\'" << file.type << "\' does not take " << numParams << " parameter(s) (expected at least " << Step_f_idx_elem << ")";
+		AddError(file, sout);
+		face.clear();
+		return false;
+	}
+	return true;
 }
 
-void OBJ::DumpWarnings(std::ostream &out, const unsigned int MaxWarnings) const
+bool OBJ::Open(File &file, const std::string &filename)
 {
-	size_t n = 0;
-	for (std::list<std::string>::const_iterator i = warnings.begin(); i != warnings.end(); ++i){
-		out << *i << std::endl;
-		if (++n == MaxWarnings) {
-			out << "<< " << warnings.size() - n << " more warning(s) >>" << std::endl;
-			break;
+	file.name = filename;
+	file.lineNo = 0;
+#ifdef OBJ_USE_MMAP
+	// map regular files directly into memory so that lines never need to be copied
+	// anything that can not be mapped (pipes, devices et al.) goes through the stream
+	const int fd = open(filename.c_str(), O_RDONLY);
+	if (fd != -1) {
+		struct stat info;
+		if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+			const size_t size = (size_t)info.st_size;
+			void *map = (size > 0) ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+			if (size == 0 || map != MAP_FAILED) {
+				if (map != NULL) {
+					madvise(map, size, MADV_SEQUENTIAL);
+					file.mapBegin = (const char*)map;
+					file.mapEnd = file.mapBegin + size;
+					file.cursor = file.mapBegin;
+				} else { // empty file, nothing to map
+					static const char empty = '\0';
+					file.mapBegin = file.mapEnd = file.cursor = &empty; // offsets are relative to mapBegin
+				}
+				close(fd);
+				return true;
+			}
+		}
+		close(fd);
+	}
+#endif
+	file.fin.open(filename.c_str());
+	if (file.fin.is_open()) {
+		return true;
+	}
+	warnings.push_back("Could not open \"" + filename + "\"");
+	return false;
+}
+
+void OBJ::ReadLine(File &file) const
+{
+	++file.lineNo;
+	if (file.IsMapped()) {
+		const char *end = (const char*)memchr(file.cursor, '\n', (size_t)(file.mapEnd - file.cursor));
+		if (end == NULL) { end = file.mapEnd; }
+		const char *begin = file.cursor;
+		file.cursor = (end != file.mapEnd) ? end + 1 : end;
+		SplitLine(begin, end, file.type, file.params);
+	} else {
+		std::getline(file.fin, file.line);
+		file.lineEnd += (long long)file.line.size() + (file.fin.eof() ? 0 : 1);
+		SplitLine(file.line.data(), file.line.data() + file.line.size(), file.type, file.params);
+	}
+}
+
+// splits a line into a keyword (type) and its parameters
+// neither includes leading or trailing blanks (including '\r' from CRLF files)
+void OBJ::SplitLine(const char *begin, const char *end, Span &type, Span &params)
+{
+	while (begin < end && (*begin == ' ' || *begin == '\t')) { ++begin; }
+	while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) { --end; }
+	const char *typeEnd = begin;
+	while (typeEnd < end && *typeEnd != ' ' && *typeEnd != '\t') { ++typeEnd; }
+	type = Span(begin, typeEnd);
+	while (typeEnd < end && (*typeEnd == ' ' || *typeEnd == '\t')) { ++typeEnd; }
+	params = Span(typeEnd, end);
+}
+
+void OBJ::AddError(const File &file, std::ostringstream &sout)
+{
+	std::string errorInfo = sout.str();
+	sout.str("");
+	sout << file.name << ": Line " << file.lineNo << ": ";
+	errors.push_back(sout.str() + errorInfo);
+	sout.str("");
+}
+
+void OBJ::AddWarning(const File &file, std::ostringstream &sout)
+{
+	std::string errorInfo = sout.str();
+	sout.str("");
+	sout << file.name << ": Line " << file.lineNo << ": ";
+	warnings.push_back(sout.str() + errorInfo);
+	sout.str("");
+}
+
+// makes room for count more elements in an element array
+// the capacity is doubled (as push_back would) here so that growth can be counted and timed, see LoadStats
+template < typename list_t >
+static inline void GrowElements(list_t &list, size_t count, size_t &allocations, double &seconds)
+{
+	if (list.size() + count > list.capacity()) {
+		const Clock::time_point start = Clock::now();
+		list.reserve(std::max(list.size() + count, list.capacity() * 2));
+		++allocations;
+		seconds += GetSeconds(start, Clock::now());
+	}
+}
+
+// handles a single line of an .obj file
+void OBJ::ReadObjLine(File &objFile, StateVariables &state)
+{
+	std::ostringstream &sout = state.sout;
+
+	const ObjKeyword keyword = GetObjKeyword(objFile.type);
+	++state.lineCount[keyword];
+	switch (keyword) {
+		case OBJ_o:
+			// read object name
+			// must be a name without spaces
+			name = objFile.params.str(); // read this straight to the main object
+			break;
+		case OBJ_v:
+			// read vertex position
+			// fourth parameter is optional
+			if (state.handler != NULL) {
+				float4 vertex = float4();
+				ReadParams(objFile, 3, 4, 1.0f, (float*)vertex);
+				++state.numVertices;
+				state.handler->OnVertex(vertex);
+			} else {
+				GrowElements(state.LOD->vertices, 1, state.allocations, state.growSeconds);
+				state.LOD->vertices.push_back(float4());
+				ReadParams(objFile, 3, 4, 1.0f, (float*)state.LOD->vertices.back());
+			}
+			break;
+		case OBJ_vt:
+			// read texture coordinates
+			// second and third parameters are optional
+			if (state.handler != NULL) {
+				float3 texCoord = float3();
+				ReadParams(objFile, 1, 3, 0.0f, (float*)texCoord);
+				++state.numTexCoords;
+				state.handler->OnTexCoord(texCoord);
+			} else {
+				GrowElements(state.LOD->texCoords, 1, state.allocations, state.growSeconds);
+				state.LOD->texCoords.push_back(float3());
+				ReadParams(objFile, 1, 3, 0.0f, (float*)state.LOD->texCoords.back());
+			}
+			break;
+		case OBJ_vn:
+			// read vertex normals
+			// no optional parameters
+			// normals need not be of unit length
+			if (state.handler != NULL) {
+				float3 normal = float3();
+				ReadParams(objFile, 3, (float*)normal);
+				++state.numNormals;
+				state.handler->OnNormal(normal);
+			} else {
+				GrowElements(state.LOD->normals, 1, state.allocations, state.growSeconds);
+				state.LOD->normals.push_back(float3());
+				ReadParams(objFile, 3, (float*)state.LOD->normals.back());
+			}
+			break;
+		case OBJ_f:
+			// read face definitions
+			// face definitions can contain any number of vertex indices
+			// indices are numbered 1 - n, not 0 - n-1, but are converted to 0 - n-1 (where -1 means "no index")
+			// for simplicity; store faces > 3 as a fan of triangles
+			if (state.handler != NULL) {
+				ReadFace(objFile, state.numVertices, state.numTexCoords, state.numNormals, state.face);
+			} else {
+				ReadFace(objFile, (int)state.LOD->vertices.size(), (int)state.LOD->texCoords.size(), (int)state.LOD->normals.size(), state.face);
+			}
+			AddFace(objFile, state);
+			break;
+		case OBJ_g: { // faces can belong to multiple groups
+			// find groups and construct a group list that all succeeding facets are part of
+			state.groups.clear();
+			const char *in = objFile.params.begin;
+			while (ReadValue(in, objFile.params.end, state.name)) {
+				state.groups.push_back(state.LOD->AddGroup(state.name));
+			}
+			if (state.groups.empty()) {
+				sout << "\'" << objFile.type << "\' does not take 0 parameter(s) (expected at least 1)";
+				AddError(objFile, sout);
+			}
+			if (state.handler != NULL) {
+				state.groupNames.resize(state.groups.size());
+				for (size_t i = 0; i < state.groups.size(); ++i) {
+					state.groupNames[i] = state.LOD->groups[state.groups[i]].name;
+				}
+				state.handler->OnGroup(state.groupNames);
+			}
+			break;
+		}
+		case OBJ_s:
+			// smoothing group of succeeding facets
+			// "off" and 0 both turn smoothing off
+			if (objFile.params == "off") {
+				state.smoothingGroup = 0;
+			} else {
+				ReadParams(objFile, 1, 1, 0, &state.smoothingGroup);
+			}
+			break;
+		case OBJ_usemtl: {
+			state.name.assign(objFile.params.begin, objFile.params.end);
+			const int material = FindMaterial(state.name);
+			if (material != -1) {
+				state.materialIndex = material;
+			} else {
+				sout << "Material \"" << objFile.params << "\" not defined";
+				AddError(objFile, sout);
+				state.materialIndex = OBJ::Facet::DEFAULT_MATERIAL;
+			}
+			if (state.handler != NULL) {
+				state.handler->OnUseMtl(state.materialIndex);
+			}
+			break;
+		}
+		case OBJ_mtllib:
+			ReadMaterialLibrary(objFile, state);
+			break;
+		case OBJ_shadow_obj:
+			// According to the standard, there can be only one
+			// shadow object per .obj file (not one for each LOD).
+			// Only the last specified shadow_obj filename is relevant.
+			shadowModel = objFile.params.str();
+			break;
+		case OBJ_lod: {
+			int lodVal = 0; // the level is reported as an error and LOD 0 is used if it can not be read
+			ReadParams(objFile, 1, &lodVal);
+			// the current groups carry over to the new LOD
+			std::vector<std::string> groupNames;
+			for (std::vector<int>::const_iterator group = state.groups.begin(); group != state.groups.end(); ++group) {
+				groupNames.push_back(state.LOD->groups[*group].name);
+			}
+			if (state.handler != NULL) { // the previous LOD has already been passed on, only its group names are kept
+				*state.LOD = OBJ::LevelOfDetail();
+				state.numVertices = state.numTexCoords = state.numNormals = state.numFacets = 0;
+				state.handler->OnLod(lodVal);
+			} else {
+				if (state.LOD->facets.size() == 0) { // LOD does not contain any relevant data
+					sout << "Previous LOD " << state.LOD->levelOfDetail << " does not contain any relevant data. Skipping...";
+					AddWarning(objFile, sout);
+					levelOfDetail.erase(state.LOD);
+				}
+				for (state.LOD = levelOfDetail.begin(); state.LOD != levelOfDetail.end(); ++state.LOD) {
+					if (lodVal >= state.LOD->levelOfDetail) {
+						break;
+					}
+				}
+				state.LOD = levelOfDetail.insert(state.LOD, OBJ::LevelOfDetail());
+			}
+			state.LOD->levelOfDetail = lodVal;
+			state.groups.clear();
+			for (std::vector<std::string>::const_iterator name = groupNames.begin(); name != groupNames.end(); ++name) {
+				state.groups.push_back(state.LOD->AddGroup(*name));
+			}
+			break;
+		}
+		case OBJ_NONE: // empty line or comment
+			break;
+		case OBJ_UNKNOWN:
+			if (state.stats != NULL) {
+				++state.stats->lines[objFile.type.str()];
+			}
+			sout << " Unknown type \'" << objFile.type << "\'";
+			AddError(objFile, sout);
+			break;
+		default: // keyword is valid, but not supported
+			sout << " \'" << objFile.type << "\' is not supported at this time";
+			AddWarning(objFile, sout);
+			break;
+	}
+}
+
+// process wide cache of parsed material libraries
+// the key is the canonical path of the library and the working directory (maps are relative to the .obj file)
+// entries are replaced when the modification time or size of the library changes
+struct MaterialCacheEntry
+{
+	time_t modified;
+	off_t size;
+	std::shared_ptr<const OBJ::MaterialTable> table;
+};
+
+static std::mutex &MaterialCacheLock( void )
+{
+	static std::mutex lock;
+	return lock;
+}
+
+static std::unordered_map<std::string, MaterialCacheEntry> &MaterialCache( void )
+{
+	static std::unordered_map<std::string, MaterialCacheEntry> cache;
+	return cache;
+}
+
+static std::string GetCanonicalPath(const std::string &filename)
+{
+#if defined(_WIN32)
+	char path[_MAX_PATH];
+	return (_fullpath(path, filename.c_str(), _MAX_PATH) != NULL) ? std::string(path) : filename;
+#else
+	char *path = realpath(filename.c_str(), NULL);
+	if (path == NULL) {
+		return filename;
+	}
+	const std::string canonicalPath(path);
+	free(path);
+	return canonicalPath;
+#endif
+}
+
+static std::shared_ptr<const OBJ::MaterialTable> CreateDefaultMaterialTable( void )
+{
+	std::shared_ptr<OBJ::MaterialTable> table(new OBJ::MaterialTable);
+	table->materials.push_back(OBJ::Material());
+	table->lineNo.push_back(0);
+	return table;
+}
+
+// the default material is shared by all OBJ:s
+static const std::shared_ptr<const OBJ::MaterialTable> &DefaultMaterialTable( void )
+{
+	static const std::shared_ptr<const OBJ::MaterialTable> table = CreateDefaultMaterialTable();
+	return table;
+}
+
+static bool FileExists(const std::string &filename)
+{
+	struct stat info;
+	return stat(filename.c_str(), &info) == 0 && (info.st_mode & S_IFMT) != S_IFDIR;
+}
+
+static long long GetFileSize(const std::string &filename)
+{
+	struct stat info;
+	return (stat(filename.c_str(), &info) == 0) ? (long long)info.st_size : 0;
+}
+
+// adds the names of the regular files in a directory to names, returns false if the directory can not be listed
+static bool ListDirectory(const std::string &directory, std::unordered_set<std::string> &names)
+{
+#if defined(__unix__) || defined(__APPLE__)
+	DIR *dir = opendir(directory.empty() ? "." : directory.c_str());
+	if (dir == NULL) {
+		return false;
+	}
+	struct stat info;
+	for (struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir)) {
+#ifdef DT_UNKNOWN
+		if (entry->d_type == DT_REG) {
+			names.insert(entry->d_name);
+			continue;
+		} else if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK) {
+			continue;
+		}
+#endif
+		// the type was not reported, or the entry is a link (links to files count as files)
+		if (stat((directory + entry->d_name).c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+			names.insert(entry->d_name);
+		}
+	}
+	closedir(dir);
+	return true;
+#else
+	(void)directory;
+	(void)names;
+	return false;
+#endif
+}
+
+// sets Material::validMaps for all materials
+// every path is only checked once, and directories that contain many of the maps are listed
+// once instead of calling stat for every map that is found
+// maps that do not exist are reported in warnings
+static void CheckMaps(std::vector<OBJ::Material> &materials, std::list<std::string> &warnings)
+{
+	static const size_t MIN_LISTED_MAPS = 16; // directories with fewer maps are checked map by map
+
+	std::unordered_map<std::string, bool> exists; // per map path
+	std::unordered_map< std::string, std::vector<std::string> > directories; // unique map paths per directory
+	for (std::vector<OBJ::Material>::const_iterator material = materials.begin(); material != materials.end(); ++material) {
+		for (int m = 0; m < OBJ::Material::MAP_COUNT; ++m) {
+			const std::string &path = (*material).*MATERIAL_MAPS[m];
+			if (!path.empty() && exists.insert(std::make_pair(path, false)).second) {
+				const size_t slash = path.find_last_of("/\\");
+				directories[path.substr(0, (slash != std::string::npos) ? slash + 1 : 0)].push_back(path);
+			}
+		}
+	}
+
+	std::unordered_set<std::string> names;
+	for (std::unordered_map< std::string, std::vector<std::string> >::const_iterator directory = directories.begin(); directory != directories.end(); ++directory) {
+		const std::vector<std::string> &paths = directory->second;
+		names.clear();
+		const bool listed = paths.size() >= MIN_LISTED_MAPS && ListDirectory(directory->first, names);
+		for (std::vector<std::string>::const_iterator path = paths.begin(); path != paths.end(); ++path) {
+			// a name that is not listed may still exist (e.g. on a case insensitive file system), so it is checked by itself
+			exists[*path] = (listed && names.count(path->substr(directory->first.size())) > 0) || FileExists(*path);
+		}
+	}
+
+	std::unordered_set<std::string> reported; // missing maps are only reported once
+	for (std::vector<OBJ::Material>::iterator material = materials.begin(); material != materials.end(); ++material) {
+		material->validMaps = 0;
+		for (int m = 0; m < OBJ::Material::MAP_COUNT; ++m) {
+			const std::string &path = (*material).*MATERIAL_MAPS[m];
+			if (path.empty()) {
+				continue;
+			} else if (exists[path]) {
+				material->validMaps |= 1u << m;
+			} else if (reported.insert(path).second) {
+				warnings.push_back("Map \"" + path + "\" does not exist");
+			}
+		}
+	}
+}
+
+// sets Material::validMaps for all maps that are named, without checking them
+static void AssumeMapsValid(std::vector<OBJ::Material> &materials)
+{
+	for (std::vector<OBJ::Material>::iterator material = materials.begin(); material != materials.end(); ++material) {
+		material->validMaps = 0;
+		for (int m = 0; m < OBJ::Material::MAP_COUNT; ++m) {
+			if (!((*material).*MATERIAL_MAPS[m]).empty()) {
+				material->validMaps |= 1u << m;
+			}
+		}
+	}
+}
+
+// returns the materials of a library, the library is only parsed if it is not in the cache (or has changed)
+// returns NULL if the library could not be opened
+std::shared_ptr<const OBJ::MaterialTable> OBJ::LoadMaterialLibrary(const std::string &filename, const std::string &workingDirectory, bool checkMaps, LoadStats *stats)
+{
+	struct stat info;
+	if (stat(filename.c_str(), &info) != 0) {
+		return std::shared_ptr<const MaterialTable>();
+	}
+	const std::string key = GetCanonicalPath(filename) + '\n' + workingDirectory + (checkMaps ? "\n1" : "\n0");
+	{
+		std::lock_guard<std::mutex> lock(MaterialCacheLock());
+		std::unordered_map<std::string, MaterialCacheEntry>::const_iterator entry = MaterialCache().find(key);
+		if (entry != MaterialCache().end() && entry->second.modified == info.st_mtime && entry->second.size == info.st_size) {
+			return entry->second.table;
+		}
+	}
+
+	// parse without holding the lock so that other libraries can be loaded meanwhile
+	const Clock::time_point start = Clock::now();
+	OBJ parser; // collects errors and warnings
+	File mtlFile;
+	if (!parser.Open(mtlFile, filename)) {
+		return std::shared_ptr<const MaterialTable>();
+	}
+	std::shared_ptr<MaterialTable> table(new MaterialTable);
+	table->fileName = mtlFile.name;
+	parser.ParseMaterialLibrary(mtlFile, workingDirectory, *table);
+	const Clock::time_point parsed = Clock::now();
+	if (checkMaps) {
+		CheckMaps(table->materials, parser.warnings);
+	} else {
+		AssumeMapsValid(table->materials);
+	}
+	if (stats != NULL) {
+		stats->seconds[LoadStats::READ_MTL] += GetSeconds(start, parsed);
+		stats->seconds[LoadStats::CHECK_MAPS] += GetSeconds(parsed, Clock::now());
+		stats->bytesRead += mtlFile.GetOffset();
+	}
+	table->errors.swap(parser.errors);
+	table->warnings.swap(parser.warnings);
+
+	std::lock_guard<std::mutex> lock(MaterialCacheLock());
+	MaterialCacheEntry &entry = MaterialCache()[key];
+	if (entry.table == NULL || entry.modified != info.st_mtime || entry.size != info.st_size) {
+		entry.modified = info.st_mtime;
+		entry.size = info.st_size;
+		entry.table = table;
+	} // else another thread parsed the same library first, use its table so that materials are only stored once
+	return entry.table;
+}
+
+void OBJ::ClearMaterialCache( void )
+{
+	std::lock_guard<std::mutex> lock(MaterialCacheLock());
+	MaterialCache().clear();
+}
+
+// reads all materials in a library into table
+// materials are not checked against other libraries here since the table is shared, see ReadMaterialLibrary
+void OBJ::ParseMaterialLibrary(File &mtlFile, const std::string &workingDirectory, MaterialTable &table)
+{
+	std::ostringstream sout;
+	std::unordered_map<std::string, int> materialLookup;
+	Material *material = NULL; // the material being defined, NULL if invalid
+
+	//
+	// Note
+	//
+	// All of the keywords are supported,
+	// albeit not fully. Keywords within
+	// the keywords are not supported at
+	// all.
+	//
+	while (!mtlFile.Eof()) {
+		ReadLine(mtlFile);
+
+		const MtlKeyword keyword = GetMtlKeyword(mtlFile.type);
+		if (keyword == MTL_newmtl) {
+			const std::string materialName = mtlFile.params.str();
+
+			if (materialName.find(" ") != std::string::npos || materialName.find("\t") != std::string::npos) {
+				sout << "Material name may not include blank characters: see \"" << materialName << "\"";
+				AddError(mtlFile, sout);
+				material = NULL; // if material name failed mtl is set to invalid value
+			} else { // name is OK
+				if (materialLookup.insert(std::make_pair(materialName, (int)table.materials.size())).second) { // if you get here, then material name passed all error checks
+					table.materials.push_back(OBJ::Material()); // automatically sets up defaults
+					table.lineNo.push_back(mtlFile.lineNo);
+					material = &table.materials.back();
+					material->name = materialName;
+				} else {
+					sout << "Redefinition of material \"" << materialName << "\"";
+					AddError(mtlFile, sout);
+					material = NULL; // set mtl to invalid value
+				}
+			}
+		} else if (material != NULL) {
+			//
+			// Note
+			//
+			// Ka, Kd, Ks et al. are not implemented correctly.
+			// Read their values as strings, not as floats, since
+			// parameters can contain keywords such as "spectral".
+			//
+			switch (keyword) {
+				case MTL_Ka: // ambient color
+					ReadParams(mtlFile, 3, (float*)material->ambient);
+					break;
+				case MTL_Kd: // diffuse color
+					ReadParams(mtlFile, 3, (float*)material->diffuse);
+					break;
+				case MTL_Ks: // specular color
+					ReadParams(mtlFile, 3, (float*)material->specular);
+					break;
+				case MTL_Ke: // emissive color
+					ReadParams(mtlFile, 3, (float*)material->emissive);
+					break;
+				case MTL_Tr: // alpha
+					ReadParams(mtlFile, 1, &material->alpha);
+					break;
+				case MTL_d: // dissolve (same as alpha?)
+					ReadParams(mtlFile, 1, &material->dissolve);
+					break;
+				case MTL_Tf: // transmission filter
+					ReadParams(mtlFile, 3, (float*)material->transmission);
+					break;
+				case MTL_Ns: // shininess
+					ReadParams(mtlFile, 1, &material->shininess);
+					break;
+				case MTL_Ni: // optical density
+					ReadParams(mtlFile, 1, &material->opticalDensity);
+					break;
+				case MTL_sharpness: // sharpness
+					ReadParams(mtlFile, 1, &material->sharpness);
+					break;
+				case MTL_illum: { // illumination
+					ReadParams(mtlFile, 1, &material->illumination);
+					int illum = material->illumination;
+					if (illum != OBJ::Material::FLAT && illum != OBJ::Material::DIFFUSE && illum != OBJ::Material::DIFFUSE_AND_SPECULAR) {
+						sout << "\'" << mtlFile.type << "\' is not set to a recognisable shader model (only flat (0), diffuse (1), diffuse + specular (2)).";
+						AddWarning(mtlFile, sout);
+					}
+					break;
+				}
+				//
+				// NOTE
+				//
+				// map_Kx can contain more information than just
+				// a file name. This is currently not supported.
+				// Maps are not opened here, see CheckMaps.
+				//
+				case MTL_map_Ka:
+					material->ambientMap = workingDirectory + mtlFile.params.str();
+					break;
+				case MTL_map_Kd:
+					material->diffuseMap = workingDirectory + mtlFile.params.str();
+					break;
+				case MTL_map_Ks:
+					material->specularMap = workingDirectory + mtlFile.params.str();
+					break;
+				case MTL_map_Ke:
+					material->emissiveMap = workingDirectory + mtlFile.params.str();
+					break;
+				case MTL_map_Tf:
+					material->transmissionMap = workingDirectory + mtlFile.params.str();
+					break;
+				case MTL_map_Ns:
+					material->shininessMap = workingDirectory + mtlFile.params.str();
+					break;
+				case MTL_map_Tr:
+					material->alphaMap = workingDirectory + mtlFile.params.str();
+					break;
+				case MTL_map_d:
+					material->dissolveMap = workingDirectory + mtlFile.params.str();
+					break;
+				case MTL_disp:
+					material->displacementMap = workingDirectory + mtlFile.params.str();
+					break;
+				case MTL_decal:
+					material->detailMap = workingDirectory + mtlFile.params.str();
+					break;
+				case MTL_bump:
+					material->bumpMap = workingDirectory + mtlFile.params.str();
+					break;
+				case MTL_NONE: // empty line or comment
+					break;
+				case MTL_UNKNOWN:
+					sout << " Unknown type \'" << mtlFile.type << "\'";
+					AddError(mtlFile, sout);
+					break;
+				default: // keyword is valid, but not supported
+					sout << " \'" << mtlFile.type << "\' is not supported at this time";
+					AddWarning(mtlFile, sout);
+					break;
+			}
+		} else if (keyword == MTL_UNKNOWN) {
+			sout << " Unknown type \'" << mtlFile.type << "\'";
+			AddError(mtlFile, sout);
+		} else if (keyword != MTL_NONE) {
+			sout << "\'" << mtlFile.type << "\' operating on undefined material";
+			AddError(mtlFile, sout);
+		}
+	}
+}
+
+// adds the materials in the library named by a "mtllib" line
+// the library is shared with other OBJ:s, so materials are referenced rather than copied
+void OBJ::ReadMaterialLibrary(const File &objFile, StateVariables &state)
+{
+	std::ostringstream &sout = state.sout;
+
+	//
+	// NOTE
+	//
+	// Each mtllib statement can contain
+	// more than one filename. This is
+	// currently not supported.
+	//
+
+	if (state.progress != NULL) { state.progress->phase = Progress::READING_MTL; }
+	const std::shared_ptr<const MaterialTable> table = LoadMaterialLibrary(state.workingDirectory + objFile.params.str(), state.workingDirectory, state.checkMaps, state.stats);
+	if (state.progress != NULL) { state.progress->phase = Progress::READING_OBJ; }
+	if (table != NULL) {
+		libraries.push_back(table->fileName);
+		errors.insert(errors.end(), table->errors.begin(), table->errors.end());
+		warnings.insert(warnings.end(), table->warnings.begin(), table->warnings.end());
+		materialLookup.reserve(materials.size() + table->materials.size());
+		for (size_t i = 0; i < table->materials.size(); ++i) {
+			const Material &material = table->materials[i];
+			if (materialLookup.insert(std::make_pair(material.name, (int)materials.size())).second) {
+				materials.push_back(table, i);
+				if (state.handler != NULL) {
+					state.handler->OnMaterial(material, (int)materials.size() - 1);
+				}
+			} else {
+				sout << table->fileName << ": Line " << table->lineNo[i] << ": Redefinition of material \"" << material.name << "\"";
+				errors.push_back(sout.str());
+				sout.str("");
+			}
+		}
+	} else {
+		sout << "Specified files could not be opened";
+		AddError(objFile, sout);
+	}
+}
+
+// validates a parsed face (see ReadFace) and stores it as a fan of triangles in the current LOD
+void OBJ::AddFace(const File &objFile, StateVariables &state)
+{
+	std::ostringstream &sout = state.sout;
+	const std::vector<int> &face = state.face;
+	if (face.size()%Step_f_idx_elem != 0) { // sanity check, makes sure that every vertex index has three elements (v/vn/vt)
+		sout << "Parsing code bug";
+		AddError(objFile, sout);
+	} else if (face.size() >= Step_f) {
+		int numUnavailable = 0;
+		size_t i;
+		for (i = 0; i < Step_f_idx; ++i) {
+			for (size_t j = i; j < face.size(); j+=Step_f_idx) { // count the number of omitted elements in the vertex index...
+				if (face[j] == -1) { ++numUnavailable; }
+			}
+			if (numUnavailable % (face.size()/Step_f_idx) != 0) { // ...must be a multiple of the number of specified vertex indices
+				// remember, this is /before/ the face definition is converted to a set of triangles, so omitted elements can be a non-multiple of 3 and still be valid.
+				sout << "Vertex index mismatch";
+				AddError(objFile, sout);
+				break;
+			}
+		}
+		if (i == Step_f_idx) { // or else error occurred
+			// convert the face into a triangle fan
+			// NOTE: if triangles are facing the wrong way, swap the order the elements are pushed
+			for (size_t i=(size_t)Step_f_idx; i < face.size()-(size_t)Step_f_idx; i+=Step_f_idx) { // numParam has guaranteed that face.size() is at least 3
+				
+				OBJ::Facet facet;
+				// vertex 1
+				facet.vertex[0] = face[IndexPos];
+				facet.texCoord[0] = face[IndexTex];
+				facet.normal[0] = face[IndexNor];
+				// vertex 2
+				facet.vertex[1] = face[i+IndexPos];
+				facet.texCoord[1] = face[i+IndexTex];
+				facet.normal[1] = face[i+IndexNor];
+				//vertex 3
+				facet.vertex[2] = face[i+Step_f_idx+IndexPos];
+				facet.texCoord[2] = face[i+Step_f_idx+IndexTex];
+				facet.normal[2] = face[i+Step_f_idx+IndexNor];
+				// material
+				facet.material = state.materialIndex;
+				facet.smoothingGroup = state.smoothingGroup;
+				if (state.handler != NULL) {
+					++state.numFacets;
+					state.handler->OnFace(facet);
+				} else {
+					GrowElements(state.LOD->facets, 1, state.allocations, state.growSeconds);
+					state.LOD->facets.push_back(facet);
+					// group
+					for (std::vector<int>::const_iterator group = state.groups.begin(); group != state.groups.end(); ++group) {
+						state.LOD->groups[*group].facets.push_back(state.LOD->facets.size() - 1);
+					}
+				}
+			}
+		}
+	}
+}
+
+// bytes held by the element arrays of all LOD:s, see LoadStats::peakBytes
+static size_t GetElementBytes(const OBJ::LODList &lods)
+{
+	size_t bytes = 0;
+	for (OBJ::LODList::const_iterator lod = lods.begin(); lod != lods.end(); ++lod) {
+		bytes += lod->vertices.capacity() * sizeof(OBJ::float4) + lod->texCoords.capacity() * sizeof(OBJ::float3) + lod->normals.capacity() * sizeof(OBJ::float3) + lod->facets.capacity() * sizeof(OBJ::Facet);
+	}
+	return bytes;
+}
+
+// parses the lines of a chunk of a mapped .obj file (called from worker threads)
+// well formed vertex data and faces are decoded here, everything else is
+// recorded and handled in order by ReadObjLine once all chunks are parsed
+void OBJ::ParseChunk(Chunk *chunk)
+{
+	const char *cursor = chunk->begin;
+	const char *reported = chunk->begin; // bytes passed to chunk->progress
+	int lineNo = 0;
+	LoadStats::Phase sampledPhase = LoadStats::PHASE_COUNT; // of the previous line if it was sampled, see LoadStats
+	Clock::time_point sampleTime;
+	size_t sampleAllocations = 0;
+	while (cursor < chunk->end) {
+		if (sampledPhase != LoadStats::PHASE_COUNT) {
+			if (chunk->allocations == sampleAllocations) { // growth is timed separately
+				AddSample(chunk->seconds, sampledPhase, sampleTime, Clock::now());
+			}
+			sampledPhase = LoadStats::PHASE_COUNT;
+		}
+		const bool sample = chunk->sampled && lineNo % LoadStats::SAMPLE_INTERVAL == 0;
+		if (sample) { sampleTime = Clock::now(); }
+		const char *end = (const char*)memchr(cursor, '\n', (size_t)(chunk->end - cursor));
+		if (end == NULL) { end = chunk->end; }
+		Span type, params;
+		SplitLine(cursor, end, type, params);
+		cursor = (end < chunk->end) ? end + 1 : end;
+		++lineNo;
+		if (chunk->progress != NULL && lineNo % Progress::CHECK_INTERVAL == 0) {
+			const bool proceed = chunk->progress->Advance(cursor - reported);
+			reported = cursor;
+			if (!proceed) { break; }
+		}
+
+		const ObjKeyword keyword = GetObjKeyword(type);
+		if (sample) {
+			const Clock::time_point now = Clock::now();
+			AddSample(chunk->seconds, LoadStats::READ_LINES, sampleTime, now);
+			sampleTime = now;
+			sampleAllocations = chunk->allocations;
+			sampledPhase = GetParsePhase(keyword);
+		}
+		if (keyword == OBJ_NONE) {
+			++chunk->lineCount[keyword];
+			continue;
+		} else if (keyword == OBJ_v) {
+			float4 vertex;
+			if (TryReadParams(params, 3, 4, 1.0f, (float*)vertex)) {
+				GrowElements(chunk->vertices, 1, chunk->allocations, chunk->seconds[LoadStats::GROW_ARRAYS]);
+				chunk->vertices.push_back(vertex);
+				++chunk->lineCount[keyword];
+				continue;
+			}
+		} else if (keyword == OBJ_vt) {
+			float3 texCoord;
+			if (TryReadParams(params, 1, 3, 0.0f, (float*)texCoord)) {
+				GrowElements(chunk->texCoords, 1, chunk->allocations, chunk->seconds[LoadStats::GROW_ARRAYS]);
+				chunk->texCoords.push_back(texCoord);
+				++chunk->lineCount[keyword];
+				continue;
+			}
+		} else if (keyword == OBJ_vn) {
+			float3 normal;
+			if (TryReadParams(params, 3, 3, 0.0f, (float*)normal)) {
+				GrowElements(chunk->normals, 1, chunk->allocations, chunk->seconds[LoadStats::GROW_ARRAYS]);
+				chunk->normals.push_back(normal);
+				++chunk->lineCount[keyword];
+				continue;
+			}
+		}
+
+		Chunk::Line line;
+		line.lineNo = lineNo;
+		line.numVertices = (int)chunk->vertices.size();
+		line.numTexCoords = (int)chunk->texCoords.size();
+		line.numNormals = (int)chunk->normals.size();
+		line.faceBegin = line.faceEnd = (int)chunk->faceIndices.size();
+		line.type = type;
+		line.params = params;
+
+		if (keyword == OBJ_f) {
+			const char *in = params.begin;
+			bool valid = true;
+			while (valid) {
+				while (in < params.end && IsBlank(*in)) { ++in; }
+				if (in == params.end) { break; }
+				int index[Step_f_idx_elem];
+				valid = DecodeFaceVertex(in, params.end, index);
+				chunk->faceIndices.insert(chunk->faceIndices.end(), index, index + Step_f_idx_elem);
+			}
+			if (valid && chunk->faceIndices.size() - (size_t)line.faceBegin >= (size_t)Step_f) {
+				line.faceEnd = (int)chunk->faceIndices.size();
+				++chunk->lineCount[keyword];
+			} else { // let ReadObjLine report the error
+				chunk->faceIndices.resize((size_t)line.faceBegin);
+			}
+		}
+		chunk->lines.push_back(line);
+	}
+	chunk->numLines = lineNo;
+	if (sampledPhase != LoadStats::PHASE_COUNT && chunk->allocations == sampleAllocations) {
+		AddSample(chunk->seconds, sampledPhase, sampleTime, Clock::now());
+	}
+	if (chunk->progress != NULL) {
+		chunk->progress->Advance(cursor - reported);
+	}
+}
+
+// parses a mapped .obj file with several threads
+// the file is split into chunks at line boundaries and each chunk is parsed in parallel
+// the chunks are then stitched together in file order, so that relative indices,
+// groups, materials and LOD:s resolve exactly as they would when reading line by line
+void OBJ::ReadObjParallel(File &objFile, StateVariables &state, int numChunks)
+{
+	std::vector<Chunk> chunks((size_t)numChunks);
+	const size_t chunkSize = (size_t)(objFile.mapEnd - objFile.cursor) / (size_t)numChunks;
+	const char *begin = objFile.cursor;
+	for (int i = 0; i < numChunks; ++i) {
+		const char *end = objFile.mapEnd;
+		if (i < numChunks - 1 && (size_t)(objFile.mapEnd - begin) > chunkSize) {
+			end = (const char*)memchr(begin + chunkSize, '\n', (size_t)(objFile.mapEnd - begin - chunkSize));
+			end = (end != NULL) ? end + 1 : objFile.mapEnd;
+		}
+		chunks[i].begin = begin;
+		chunks[i].end = end;
+		chunks[i].progress = state.progress;
+		chunks[i].sampled = (state.stats != NULL);
+		begin = end;
+	}
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < numChunks; ++i) {
+		threads.push_back(std::thread(ParseChunk, &chunks[i]));
+	}
+	ParseChunk(&chunks[0]);
+	for (size_t i = 0; i < threads.size(); ++i) {
+		threads[i].join();
+	}
+
+	const Clock::time_point stitchStart = Clock::now();
+	const double growSeconds = state.growSeconds; // material libraries are read and arrays grow while stitching, but both are timed separately
+	double mtlSeconds = 0.0;
+	size_t chunkBytes = 0; // held by the chunks that have not been stitched yet
+	for (int i = 0; i < numChunks; ++i) {
+		for (int k = 0; k < OBJ_KEYWORD_COUNT; ++k) {
+			state.lineCount[k] += chunks[i].lineCount[k];
+		}
+		state.allocations += chunks[i].allocations;
+		if (state.stats != NULL) {
+			for (int p = 0; p < LoadStats::PHASE_COUNT; ++p) {
+				state.stats->seconds[p] += chunks[i].seconds[p];
+			}
+			chunkBytes += chunks[i].GetBytes();
+		}
+	}
+	if (state.stats != NULL) {
+		mtlSeconds = state.stats->seconds[LoadStats::READ_MTL] + state.stats->seconds[LoadStats::CHECK_MAPS];
+		state.stats->peakBytes = std::max(state.stats->peakBytes, chunkBytes);
+	}
+
+	int firstLine = objFile.lineNo;
+	for (int i = 0; i < numChunks; ++i) {
+		if (state.progress != NULL && state.progress->IsCancelled()) { break; }
+		Chunk &chunk = chunks[i];
+		size_t numVertices = 0, numTexCoords = 0, numNormals = 0; // number of elements moved to the LOD
+		for (size_t l = 0; l <= chunk.lines.size(); ++l) {
+			// move vertex data preceding the line to the current LOD
+			const bool lastLine = (l == chunk.lines.size());
+			const size_t vertexEnd = lastLine ? chunk.vertices.size() : (size_t)chunk.lines[l].numVertices;
+			const size_t texCoordEnd = lastLine ? chunk.texCoords.size() : (size_t)chunk.lines[l].numTexCoords;
+			const size_t normalEnd = lastLine ? chunk.normals.size() : (size_t)chunk.lines[l].numNormals;
+			GrowElements(state.LOD->vertices, vertexEnd - numVertices, state.allocations, state.growSeconds);
+			GrowElements(state.LOD->texCoords, texCoordEnd - numTexCoords, state.allocations, state.growSeconds);
+			GrowElements(state.LOD->normals, normalEnd - numNormals, state.allocations, state.growSeconds);
+			state.LOD->vertices.insert(state.LOD->vertices.end(), chunk.vertices.begin() + numVertices, chunk.vertices.begin() + vertexEnd);
+			state.LOD->texCoords.insert(state.LOD->texCoords.end(), chunk.texCoords.begin() + numTexCoords, chunk.texCoords.begin() + texCoordEnd);
+			state.LOD->normals.insert(state.LOD->normals.end(), chunk.normals.begin() + numNormals, chunk.normals.begin() + normalEnd);
+			numVertices = vertexEnd;
+			numTexCoords = texCoordEnd;
+			numNormals = normalEnd;
+			if (lastLine) { break; }
+
+			const Chunk::Line &line = chunk.lines[l];
+			objFile.lineNo = firstLine + line.lineNo;
+			objFile.type = line.type;
+			objFile.params = line.params;
+			if (line.faceBegin != line.faceEnd) {
+				const int size[Step_f_idx_elem] = { (int)state.LOD->vertices.size(), (int)state.LOD->texCoords.size(), (int)state.LOD->normals.size() };
+				state.face.assign(chunk.faceIndices.begin() + line.faceBegin, chunk.faceIndices.begin() + line.faceEnd);
+				for (size_t j = 0; j < state.face.size(); j += Step_f_idx_elem) {
+					ResolveFaceVertex(objFile, size, &state.face[j]);
+				}
+				AddFace(objFile, state);
+			} else {
+				ReadObjLine(objFile, state);
+			}
+		}
+		firstLine += chunk.numLines;
+		if (state.stats != NULL) {
+			state.stats->peakBytes = std::max(state.stats->peakBytes, GetElementBytes(levelOfDetail) + chunkBytes);
+			chunkBytes -= chunk.GetBytes();
+		}
+		// release memory as early as possible
+		VertexList().swap(chunk.vertices);
+		TexCoordList().swap(chunk.texCoords);
+		NormalList().swap(chunk.normals);
+		std::vector<int>().swap(chunk.faceIndices);
+		std::vector<Chunk::Line>().swap(chunk.lines);
+	}
+	objFile.lineNo = firstLine;
+	objFile.cursor = objFile.mapEnd;
+	if (state.stats != NULL) {
+		const double stitchMtlSeconds = state.stats->seconds[LoadStats::READ_MTL] + state.stats->seconds[LoadStats::CHECK_MAPS] - mtlSeconds;
+		state.stats->seconds[LoadStats::STITCH_CHUNKS] += GetSeconds(stitchStart, Clock::now()) - stitchMtlSeconds - (state.growSeconds - growSeconds);
+	}
+}
+
+// http://paulbourke.net/dataformats/obj/
+// http://www.fileformat.info/format/material/
+// To do:
+// No full support for .MTL files. See documentation.
+// HOW ARE MATERIALS ASSIGNED TO A SINGLE VERTEX INSTEAD OF A FACE? (c_interp)
+// Add support for line continuation using "\" as token.
+// Error handling for "name", "g" and "shadowModel" (shadowModel may only take one file)
+// BUG: "mtllib" and "map_Ka" "shadowModel" do not handle paths with spaces properly. Add support for "-token.
+// Remove the possibility to input several filenames in mtllib, map_Ka et al. Not necessary.
+OBJ::OBJ(const std::string &filename, const Options &options) :
+	fileName(filename),
+	name(),
+	shadowModel(),
+	levelOfDetail(),
+	materials()
+{
+	const Clock::time_point start = Clock::now();
+	if (options.stats != NULL) { *options.stats = LoadStats(); }
+	if (options.progress != NULL) { options.progress->Restart(); }
+	bool cached = false;
+	if (!options.cacheFile.empty()) {
+		if (options.progress != NULL) { options.progress->phase = Progress::READING_CACHE; }
+		cached = ReadBinary(options.cacheFile, filename);
+		if (options.stats != NULL) {
+			options.stats->seconds[LoadStats::READ_CACHE] = GetSeconds(start, Clock::now());
+			if (cached) {
+				options.stats->bytesRead += GetFileSize(options.cacheFile);
+				options.stats->peakBytes = GetElementBytes(levelOfDetail);
+			}
+		}
+		if (!cached) {
+			Clear(); // out of date or invalid, parse the .obj instead
+			fileName = filename;
+		}
+	}
+
+	if (!cached) {
+		Read(filename, options, NULL);
+	}
+
+	if (options.progress != NULL) { options.progress->phase = Progress::POST_PROCESSING; }
+	const Clock::time_point postStart = Clock::now();
+	if (options.generateNormals && errors.empty()) { // also done for cached files, in case the cache was written without normals
+		for (LODList::iterator lod = levelOfDetail.begin(); lod != levelOfDetail.end() && (options.progress == NULL || !options.progress->IsCancelled()); ++lod) {
+			lod->GenerateNormals();
+		}
+	}
+
+	CheckCancelled(filename, options.progress);
+	if (!cached && !options.cacheFile.empty() && errors.empty() && !SaveBinary(options.cacheFile)) {
+		warnings.push_back("\"" + options.cacheFile + "\": Binary cache could not be written");
+	}
+	if (options.stats != NULL) {
+		const Clock::time_point end = Clock::now();
+		options.stats->seconds[LoadStats::POST_PROCESS] = GetSeconds(postStart, end);
+		options.stats->peakBytes = std::max(options.stats->peakBytes, GetElementBytes(levelOfDetail));
+		options.stats->totalSeconds = GetSeconds(start, end);
+	}
+	if (options.progress != NULL) { options.progress->phase = Progress::DONE; }
+}
+
+OBJ::OBJ(const std::string &filename, Handler &handler, const Options &options) :
+	fileName(filename),
+	name(),
+	shadowModel(),
+	levelOfDetail(),
+	materials()
+{
+	const Clock::time_point start = Clock::now();
+	if (options.stats != NULL) { *options.stats = LoadStats(); }
+	if (options.progress != NULL) { options.progress->Restart(); }
+	Read(filename, options, &handler);
+	CheckCancelled(filename, options.progress);
+	levelOfDetail.clear(); // only used for group names while streaming
+	if (options.stats != NULL) { options.stats->totalSeconds = GetSeconds(start, Clock::now()); }
+	if (options.progress != NULL) { options.progress->phase = Progress::DONE; }
+}
+
+void OBJ::Read(const std::string &filename, const Options &options, Handler *handler)
+{
+	// generate the working directory so that calls to 'mtllib' can be relative to the .obj file instead of the executable.
+	size_t lastDirectory = std::string::npos;
+	const size_t lastForwardSlash = filename.find_last_of('/');
+	if (lastForwardSlash != std::string::npos) { lastDirectory = lastForwardSlash; }
+	const size_t lastBackslash = filename.find_last_of('\\');
+	if (lastBackslash != std::string::npos) {
+		if (lastForwardSlash == std::string::npos) {
+			lastDirectory = lastForwardSlash;
+		} else {
+			lastDirectory = (lastForwardSlash > lastBackslash) ? lastForwardSlash : lastBackslash;
+		}
+	}
+
+	StateVariables state;
+	state.handler = handler;
+	state.checkMaps = options.checkMaps;
+	state.progress = options.progress;
+	state.stats = options.stats;
+	if (state.progress != NULL) { state.progress->phase = Progress::READING_OBJ; }
+	if (lastDirectory != std::string::npos) {
+		state.workingDirectory = filename.substr(0, lastDirectory + 1);
+	}
+	levelOfDetail.push_back(OBJ::LevelOfDetail());
+	state.LOD = levelOfDetail.begin();
+	state.groups.push_back(state.LOD->AddGroup(OBJ::Group().name));
+	materials.push_back(DefaultMaterialTable(), 0); // a default material
+	materialLookup[materials.back().name] = 0;
+	if (handler != NULL) {
+		handler->OnMaterial(materials.front(), 0);
+	}
+	
+	std::ostringstream &sout = state.sout; // for concatenating error/warning strings
+	File objFile; // handles the input stream from the file
+
+	if (Open(objFile, filename)) {
+
+		fileName = filename;
+		if (state.progress != NULL) {
+			state.progress->totalBytes = objFile.IsMapped() ? (long long)(objFile.mapEnd - objFile.mapBegin) : GetFileSize(filename);
+		}
+
+		// large mapped files are split up and parsed by several threads
+		// (streaming to a handler is always sequential)
+		int numChunks = (options.threads > 0) ? options.threads : (int)std::thread::hardware_concurrency();
+		if (objFile.IsMapped() && handler == NULL) {
+			const size_t maxChunks = (size_t)(objFile.mapEnd - objFile.cursor) / Chunk::MIN_SIZE;
+			if ((size_t)numChunks > maxChunks) { numChunks = (int)maxChunks; }
+		} else {
+			numChunks = 1;
+		}
+
+		if (numChunks > 1) {
+			ReadObjParallel(objFile, state, numChunks);
+		} else {
+			long long reported = 0; // bytes passed to state.progress
+			while (!objFile.Eof()) {
+
+				if (state.stats == NULL || objFile.lineNo % LoadStats::SAMPLE_INTERVAL != 0) {
+					ReadLine(objFile);
+					ReadObjLine(objFile, state);
+				} else { // sampled, see LoadStats
+					const Clock::time_point start = Clock::now();
+					ReadLine(objFile);
+					const Clock::time_point read = Clock::now();
+					const ObjKeyword keyword = GetObjKeyword(objFile.type);
+					const size_t allocations = state.allocations;
+					ReadObjLine(objFile, state);
+					AddSample(state.stats->seconds, LoadStats::READ_LINES, start, read);
+					if (keyword != OBJ_mtllib && state.allocations == allocations) { // material libraries and growth are timed separately
+						AddSample(state.stats->seconds, GetParsePhase(keyword), read, Clock::now());
+					}
+				}
+
+				if (state.progress != NULL && objFile.lineNo % Progress::CHECK_INTERVAL == 0) {
+					const bool proceed = state.progress->Advance(objFile.GetOffset() - reported);
+					reported = objFile.GetOffset();
+					if (!proceed) { break; }
+				}
+			}
+			if (state.progress != NULL) {
+				state.progress->Advance(objFile.GetOffset() - reported);
+			}
+		}
+		if ((handler != NULL ? (size_t)state.numFacets : state.LOD->facets.size()) == 0) {
+			sout << "File does not contain any face definitions";
+			warnings.push_back(sout.str());
+			sout.str("");
+		}
+	} else {
+		sout << "\"" << objFile.name << "\": File could not be opened";
+		errors.push_back(sout.str());
+		sout.str("");
+	}
+
+	if (state.stats != NULL) {
+		state.stats->bytesRead += objFile.GetOffset();
+		state.stats->allocations += state.allocations;
+		state.stats->seconds[LoadStats::GROW_ARRAYS] += state.growSeconds;
+		state.stats->peakBytes = std::max(state.stats->peakBytes, GetElementBytes(levelOfDetail));
+		AddLineCounts(state.lineCount, *state.stats);
+	}
+}
+
+int OBJ::LevelOfDetail::AddGroup(const std::string &groupName)
+{
+	std::pair<std::unordered_map<std::string, int>::iterator, bool> group = groupLookup.insert(std::make_pair(groupName, (int)groups.size()));
+	if (group.second) { // the group does not exist, create new group
+		groups.push_back(Group());
+		groups.back().name = groupName;
+	}
+	return group.first->second;
+}
+
+int OBJ::LevelOfDetail::FindGroup(const std::string &groupName) const
+{
+	std::unordered_map<std::string, int>::const_iterator group = groupLookup.find(groupName);
+	return (group != groupLookup.end()) ? group->second : -1;
+}
+
+static inline unsigned int HashIndices(int v, int vt, int vn)
+{
+	unsigned int h = (unsigned int)v * 0x9E3779B1u ^ (unsigned int)vt * 0x85EBCA77u ^ (unsigned int)vn * 0xC2B2AE3Du;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 12;
+	return h;
+}
+
+// returns the number of unique v/vt/vn combinations and an index to one of them for every facet corner
+// keys receives the v/vt/vn of each unique combination
+size_t OBJ::LevelOfDetail::WeldIndices(std::vector<unsigned int> &indices, std::vector<int> *keys) const
+{
+	// open addressing with linear probing
+	// every facet corner can at most add one vertex, so sizing the table
+	// from the number of corners keeps it at most 3/4 full without rehashing
+	const size_t numCorners = facets.size() * Step_f_idx;
+	size_t capacity = 16;
+	while (capacity < numCorners + numCorners / 3 + 1) {
+		capacity *= 2;
+	}
+	const size_t mask = capacity - 1;
+	std::vector<int> table(capacity, -1); // index into keys
+	std::vector<int> localKeys;
+	std::vector<int> &key = (keys != NULL) ? *keys : localKeys;
+	key.clear();
+	key.reserve(vertices.size() * Step_f_idx_elem);
+	indices.resize(numCorners);
+
+	size_t numUnique = 0;
+	unsigned int *index = indices.empty() ? NULL : &indices[0];
+	for (FacetList::const_iterator facet = facets.begin(); facet != facets.end(); ++facet) {
+		for (int i = 0; i < Step_f_idx; ++i) {
+			const int v = facet->vertex[i];
+			const int vt = facet->texCoord[i];
+			const int vn = facet->normal[i];
+			size_t slot = HashIndices(v, vt, vn) & mask;
+			while (table[slot] != -1) {
+				const int *k = &key[table[slot] * Step_f_idx_elem];
+				if (k[IndexPos] == v && k[IndexTex] == vt && k[IndexNor] == vn) {
+					break;
+				}
+				slot = (slot + 1) & mask;
+			}
+			if (table[slot] == -1) {
+				table[slot] = (int)numUnique++;
+				key.push_back(v);
+				key.push_back(vt);
+				key.push_back(vn);
+			}
+			*index++ = (unsigned int)table[slot];
+		}
+	}
+	return numUnique;
+}
+
+void OBJ::LevelOfDetail::BuildIndexedMesh(IndexedMesh &mesh) const
+{
+	std::vector<int> keys;
+	mesh.vertices.resize(WeldIndices(mesh.indices32, &keys));
+	mesh.indices16.clear();
+
+	for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+		const int v = keys[i * Step_f_idx_elem + IndexPos];
+		const int vt = keys[i * Step_f_idx_elem + IndexTex];
+		const int vn = keys[i * Step_f_idx_elem + IndexNor];
+		Vertex &vertex = mesh.vertices[i];
+		for (int j = 0; j < 4; ++j) { vertex.position[j] = (v >= 0 && v < (int)vertices.size()) ? vertices[v][j] : 0.0f; }
+		for (int j = 0; j < 3; ++j) { vertex.texCoord[j] = (vt >= 0 && vt < (int)texCoords.size()) ? texCoords[vt][j] : 0.0f; }
+		for (int j = 0; j < 3; ++j) { vertex.normal[j] = (vn >= 0 && vn < (int)normals.size()) ? normals[vn][j] : 0.0f; }
+	}
+
+	if (mesh.vertices.size() <= 0x10000) { // fits in 16 bit indices
+		mesh.indices16.assign(mesh.indices32.begin(), mesh.indices32.end());
+		std::vector<unsigned int>().swap(mesh.indices32);
+	}
+}
+
+OBJ::CacheStatistics OBJ::LevelOfDetail::GetCacheStatistics(int cacheSize) const
+{
+	std::vector<unsigned int> indices;
+	const size_t numUnique = WeldIndices(indices, NULL);
+	// FIFO cache, a vertex is in the cache if it was transformed less than cacheSize misses ago
+	std::vector<size_t> transformed(numUnique, 0); // miss count at the time the vertex was last transformed (+1, 0 = never)
+	size_t numMisses = 0;
+	for (std::vector<unsigned int>::const_iterator index = indices.begin(); index != indices.end(); ++index) {
+		if (transformed[*index] == 0 || numMisses - transformed[*index] >= (size_t)cacheSize) {
+			transformed[*index] = ++numMisses;
+		}
+	}
+	CacheStatistics stats;
+	stats.ACMR = facets.empty() ? 0.0f : (float)numMisses / facets.size();
+	stats.ATVR = (numUnique == 0) ? 0.0f : (float)numMisses / numUnique;
+	return stats;
+}
+
+// runs receives the first facet of every run of facets with the same groups and material, followed by the number of facets
+void OBJ::LevelOfDetail::FindRuns(std::vector<int> &runs) const
+{
+	const int numFacets = (int)facets.size();
+	std::vector<char> boundary(numFacets + 1, 0);
+	boundary[0] = boundary[numFacets] = 1;
+	for (GroupList::const_iterator group = groups.begin(); group != groups.end(); ++group) {
+		const FacetIndexList::RangeList &ranges = group->facets.GetRanges();
+		for (FacetIndexList::RangeList::const_iterator range = ranges.begin(); range != ranges.end(); ++range) {
+			boundary[range->begin] = boundary[range->end] = 1;
+		}
+	}
+	for (int i = 1; i < numFacets; ++i) {
+		if (facets[i].material != facets[i - 1].material) {
+			boundary[i] = 1;
+		}
+	}
+	runs.clear();
+	for (int i = (numFacets > 0) ? 0 : 1; i <= numFacets; ++i) {
+		if (boundary[i]) {
+			runs.push_back(i);
+		}
+	}
+}
+
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+struct VertexCacheScoreTable
+{
+	static const int MAX_TRIANGLES = 64; // vertices with more triangles left get the same boost
+	float position[OBJ::LevelOfDetail::VERTEX_CACHE_SIZE];
+	float triangles[MAX_TRIANGLES];
+	VertexCacheScoreTable( void )
+	{
+		for (int i = 0; i < OBJ::LevelOfDetail::VERTEX_CACHE_SIZE; ++i) {
+			// vertices of the last triangle get a fixed score to not favor any of its edges
+			position[i] = (i < 3) ? 0.75f : powf(1.0f - (i - 3) / (float)(OBJ::LevelOfDetail::VERTEX_CACHE_SIZE - 3), 1.5f);
+		}
+		triangles[0] = 0.0f;
+		for (int i = 1; i < MAX_TRIANGLES; ++i) {
+			triangles[i] = 2.0f / sqrtf((float)i); // boost vertices with few triangles left so that they do not linger
+		}
+	}
+};
+
+static float VertexCacheScore(int cachePosition, int numTriangles)
+{
+	static const VertexCacheScoreTable table;
+	if (numTriangles == 0) { // no triangles left to add
+		return -1.0f;
+	}
+	const float score = (cachePosition >= 0) ? table.position[cachePosition] : 0.0f;
+	return score + table.triangles[(numTriangles < VertexCacheScoreTable::MAX_TRIANGLES) ? numTriangles : VertexCacheScoreTable::MAX_TRIANGLES - 1];
+}
+
+void OBJ::LevelOfDetail::OptimizeVertexCache( void )
+{
+	const int numFacets = (int)facets.size();
+	std::vector<unsigned int> indices;
+	const int numUnique = (int)WeldIndices(indices, NULL);
+
+	// facets only move within their run, so group ranges remain valid
+	std::vector<int> runs;
+	FindRuns(runs);
+
+	// facets that use each vertex
+	std::vector<int> adjacencyOffset(numUnique + 1, 0);
+	for (int i = 0; i < numFacets * Step_f_idx; ++i) {
+		++adjacencyOffset[indices[i] + 1];
+	}
+	for (int v = 0; v < numUnique; ++v) {
+		adjacencyOffset[v + 1] += adjacencyOffset[v];
+	}
+	std::vector<int> adjacency(numFacets * Step_f_idx);
+	std::vector<int> adjacencyEnd(adjacencyOffset.begin(), adjacencyOffset.end() - 1); // added facets are removed from the lists
+	for (int i = 0; i < numFacets * Step_f_idx; ++i) {
+		adjacency[adjacencyEnd[indices[i]]++] = i / Step_f_idx;
+	}
+
+	std::vector<int> numTriangles(numUnique, 0); // facets left to add in the current run
+	std::vector<int> cachePosition(numUnique, -1);
+	std::vector<float> vertexScore(numUnique, 0.0f);
+	std::vector<float> facetScore(numFacets, 0.0f);
+	std::vector<char> added(numFacets, 0);
+	std::vector<int> cache, newCache;
+	cache.reserve(VERTEX_CACHE_SIZE + Step_f_idx);
+	newCache.reserve(VERTEX_CACHE_SIZE + Step_f_idx);
+	FacetList optimized;
+	optimized.reserve(numFacets);
+
+	for (size_t run = 0; run + 1 < runs.size(); ++run) {
+		const int runBegin = runs[run];
+		const int runEnd = runs[run + 1];
+
+		for (int i = runBegin * Step_f_idx; i < runEnd * Step_f_idx; ++i) {
+			++numTriangles[indices[i]];
+		}
+		for (int i = runBegin * Step_f_idx; i < runEnd * Step_f_idx; ++i) {
+			vertexScore[indices[i]] = VertexCacheScore(-1, numTriangles[indices[i]]);
+		}
+		int best = runBegin;
+		for (int f = runBegin; f < runEnd; ++f) {
+			const unsigned int *index = &indices[f * Step_f_idx];
+			facetScore[f] = vertexScore[index[0]] + vertexScore[index[1]] + vertexScore[index[2]];
+			if (facetScore[f] > facetScore[best]) { best = f; }
+		}
+
+		int next = runBegin; // fallback when no facet in the cache is left, first facet not yet added
+		for (int numAdded = 0; numAdded < runEnd - runBegin; ++numAdded) {
+			if (best == -1) {
+				while (added[next]) { ++next; }
+				best = next;
+			}
+			added[best] = 1;
+			optimized.push_back(facets[best]);
+
+			// the vertices of the added facet move to the front of the cache
+			const unsigned int *index = &indices[best * Step_f_idx];
+			newCache.clear();
+			for (int i = 0; i < Step_f_idx; ++i) {
+				newCache.push_back((int)index[i]);
+				--numTriangles[index[i]];
+				int a = adjacencyOffset[index[i]];
+				while (adjacency[a] != best) { ++a; }
+				adjacency[a] = adjacency[--adjacencyEnd[index[i]]];
+			}
+			for (std::vector<int>::const_iterator v = cache.begin(); v != cache.end(); ++v) {
+				if (*v != (int)index[0] && *v != (int)index[1] && *v != (int)index[2]) {
+					newCache.push_back(*v);
+				}
+			}
+			for (int i = 0; i < (int)newCache.size(); ++i) {
+				const int v = newCache[i];
+				cachePosition[v] = (i < VERTEX_CACHE_SIZE) ? i : -1;
+				vertexScore[v] = VertexCacheScore(cachePosition[v], numTriangles[v]);
+			}
+
+			// the best facet to add next uses a vertex in the cache
+			best = -1;
+			float bestScore = -1.0f;
+			for (std::vector<int>::const_iterator v = newCache.begin(); v != newCache.end(); ++v) {
+				for (int a = adjacencyOffset[*v]; a < adjacencyEnd[*v]; ++a) {
+					const int f = adjacency[a];
+					if (f >= runEnd) { continue; } // facets of previous runs have been removed already
+					const unsigned int *fi = &indices[f * Step_f_idx];
+					facetScore[f] = vertexScore[fi[0]] + vertexScore[fi[1]] + vertexScore[fi[2]];
+					if (facetScore[f] > bestScore) {
+						bestScore = facetScore[f];
+						best = f;
+					}
+				}
+			}
+			if (newCache.size() > (size_t)VERTEX_CACHE_SIZE) {
+				newCache.resize(VERTEX_CACHE_SIZE);
+			}
+			cache.swap(newCache);
+		}
+
+		for (std::vector<int>::const_iterator v = cache.begin(); v != cache.end(); ++v) { // the next run starts with a cold cache
+			cachePosition[*v] = -1;
+		}
+		cache.clear();
+	}
+
+	facets.swap(optimized);
+}
+
+void OBJ::LevelOfDetail::SortByMaterial( void )
+{
+	batches.clear();
+	if (facets.empty()) {
+		return;
+	}
+
+	// counting sort, stable so that facets keep their order (and mostly their groups) within each material
+	int minMaterial = facets.front().material;
+	int maxMaterial = minMaterial;
+	bool isSorted = true;
+	for (FacetList::const_iterator facet = facets.begin(); facet != facets.end(); ++facet) {
+		if (facet->material < maxMaterial) { isSorted = false; }
+		if (facet->material < minMaterial) { minMaterial = facet->material; }
+		if (facet->material > maxMaterial) { maxMaterial = facet->material; }
+	}
+	std::vector<int> first(maxMaterial - minMaterial + 2, 0);
+	for (FacetList::const_iterator facet = facets.begin(); facet != facets.end(); ++facet) {
+		++first[facet->material - minMaterial + 1];
+	}
+	for (size_t m = 1; m < first.size(); ++m) {
+		if (first[m] > 0) {
+			Batch batch = { minMaterial + (int)m - 1, first[m - 1], first[m] };
+			batches.push_back(batch);
+		}
+		first[m] += first[m - 1];
+	}
+	if (isSorted) {
+		return;
+	}
+
+	std::vector<int> newIndex(facets.size());
+	FacetList sorted(facets.size());
+	for (size_t i = 0; i < facets.size(); ++i) {
+		newIndex[i] = first[facets[i].material - minMaterial]++;
+		sorted[newIndex[i]] = facets[i];
+	}
+	facets.swap(sorted);
+
+	// groups refer to facets by index
+	std::vector<int> indices;
+	for (GroupList::iterator group = groups.begin(); group != groups.end(); ++group) {
+		indices.clear();
+		for (FacetIndexList::const_iterator index = group->facets.begin(); index != group->facets.end(); ++index) {
+			indices.push_back(newIndex[*index]);
+		}
+		std::sort(indices.begin(), indices.end());
+		group->facets.clear();
+		for (std::vector<int>::const_iterator index = indices.begin(); index != indices.end(); ++index) {
+			group->facets.push_back(*index);
+		}
+	}
+}
+
+struct MeshletRun // facets [begin, end) that are split into meshlets by one thread
+{
+	int begin;
+	int end;
+	std::vector<OBJ::Meshlet> meshlets;
+	std::vector<unsigned int> vertices; // firstVertex of the meshlets is relative to the run
+};
+
+struct MeshletJob // shared by all threads, each thread handles every stride:th run starting at its own first run
+{
+	const OBJ::float4 *positions; // position of every unique vertex
+	const unsigned int *indices; // welded indices of all facets
+	size_t numUnique;
+	unsigned char *localIndices; // output, threads write disjoint ranges
+	std::vector<MeshletRun> *runs;
+	size_t firstRun;
+	size_t stride;
+};
+
+static void ComputeMeshletBounds(const OBJ::float4 *positions, const unsigned int *indices, const unsigned int *vertices, OBJ::Meshlet &meshlet)
+{
+	// bounding sphere around the center of the bounding box
+	float minimum[3], maximum[3];
+	for (int j = 0; j < 3; ++j) {
+		minimum[j] = maximum[j] = positions[vertices[0]][j];
+	}
+	for (int i = 1; i < meshlet.vertexCount; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			const float p = positions[vertices[i]][j];
+			if (p < minimum[j]) { minimum[j] = p; }
+			if (p > maximum[j]) { maximum[j] = p; }
+		}
+	}
+	float radius = 0.0f;
+	for (int j = 0; j < 3; ++j) {
+		meshlet.center[j] = (minimum[j] + maximum[j]) * 0.5f;
+	}
+	for (int i = 0; i < meshlet.vertexCount; ++i) {
+		float distance = 0.0f;
+		for (int j = 0; j < 3; ++j) {
+			const float d = positions[vertices[i]][j] - meshlet.center[j];
+			distance += d * d;
+		}
+		if (distance > radius) { radius = distance; }
+	}
+	meshlet.radius = sqrtf(radius);
+
+	// normal cone around the average facet normal
+	float normals[OBJ::Meshlet::MAX_FACETS * 3];
+	int numNormals = 0;
+	float axis[3] = { 0.0f, 0.0f, 0.0f };
+	for (int f = 0; f < meshlet.facetCount; ++f) {
+		const unsigned int *index = &indices[(meshlet.firstFacet + f) * 3];
+		const float *p0 = positions[index[0]];
+		const float *p1 = positions[index[1]];
+		const float *p2 = positions[index[2]];
+		const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		const float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length > 0.0f) { // degenerate facets have no normal
+			for (int j = 0; j < 3; ++j) {
+				n[j] /= length;
+				axis[j] += n[j];
+				normals[numNormals++] = n[j];
+			}
+		}
+	}
+	const float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	meshlet.coneCutoff = -1.0f;
+	for (int j = 0; j < 3; ++j) {
+		meshlet.coneAxis[j] = (length > 0.0f) ? axis[j] / length : 0.0f;
+	}
+	if (length > 0.0f) {
+		meshlet.coneCutoff = 1.0f;
+		for (int i = 0; i < numNormals; i += 3) {
+			const float d = normals[i] * meshlet.coneAxis[0] + normals[i + 1] * meshlet.coneAxis[1] + normals[i + 2] * meshlet.coneAxis[2];
+			if (d < meshlet.coneCutoff) { meshlet.coneCutoff = d; }
+		}
+	}
+}
+
+static void BuildMeshletRuns(MeshletJob *job)
+{
+	std::vector<int> localIndex(job->numUnique, -1); // index of a vertex in the current meshlet
+	for (size_t r = job->firstRun; r < job->runs->size(); r += job->stride) {
+		MeshletRun &run = (*job->runs)[r];
+		OBJ::Meshlet meshlet;
+		meshlet.firstFacet = run.begin;
+		meshlet.facetCount = 0;
+		meshlet.firstVertex = 0;
+		meshlet.vertexCount = 0;
+		for (int f = run.begin; f <= run.end; ++f) {
+			// count the vertices the facet would add to the meshlet
+			const unsigned int *index = &job->indices[f * 3];
+			int numNew = 0;
+			if (f < run.end) {
+				for (int i = 0; i < 3; ++i) {
+					if (localIndex[index[i]] == -1 && (i < 1 || index[i] != index[0]) && (i < 2 || index[i] != index[1])) { ++numNew; }
+				}
+			}
+			// close the meshlet when it is full (or at the end of the run)
+			if (f == run.end || meshlet.vertexCount + numNew > OBJ::Meshlet::MAX_VERTICES || meshlet.facetCount == OBJ::Meshlet::MAX_FACETS) {
+				if (meshlet.facetCount > 0) {
+					const unsigned int *vertices = &run.vertices[meshlet.firstVertex];
+					ComputeMeshletBounds(job->positions, job->indices, vertices, meshlet);
+					for (int i = 0; i < meshlet.vertexCount; ++i) {
+						localIndex[vertices[i]] = -1;
+					}
+					run.meshlets.push_back(meshlet);
+				}
+				meshlet.firstFacet = f;
+				meshlet.facetCount = 0;
+				meshlet.firstVertex = (int)run.vertices.size();
+				meshlet.vertexCount = 0;
+				if (f == run.end) {
+					break;
+				}
+			}
+			for (int i = 0; i < 3; ++i) {
+				if (localIndex[index[i]] == -1) {
+					localIndex[index[i]] = meshlet.vertexCount++;
+					run.vertices.push_back(index[i]);
+				}
+				job->localIndices[f * 3 + i] = (unsigned char)localIndex[index[i]];
+			}
+			++meshlet.facetCount;
+		}
+	}
+}
+
+void OBJ::LevelOfDetail::BuildMeshlets(MeshletList &meshlets, int threads) const
+{
+	meshlets.meshlets.clear();
+	meshlets.vertices.clear();
+	meshlets.indices.resize(facets.size() * Step_f_idx);
+
+	std::vector<unsigned int> indices;
+	std::vector<int> keys;
+	const size_t numUnique = WeldIndices(indices, &keys);
+	std::vector<float4> positions(numUnique);
+	for (size_t i = 0; i < numUnique; ++i) {
+		const int v = keys[i * Step_f_idx_elem + IndexPos];
+		for (int j = 0; j < 4; ++j) { positions[i][j] = (v >= 0 && v < (int)vertices.size()) ? vertices[v][j] : 0.0f; }
+	}
+
+	std::vector<int> runBegins;
+	FindRuns(runBegins);
+	std::vector<MeshletRun> runs(runBegins.empty() ? 0 : runBegins.size() - 1);
+	for (size_t r = 0; r < runs.size(); ++r) {
+		runs[r].begin = runBegins[r];
+		runs[r].end = runBegins[r + 1];
+	}
+
+	// runs are independent, so they are split up between threads
+	size_t numThreads = (threads > 0) ? (size_t)threads : (size_t)std::thread::hardware_concurrency();
+	if (numThreads > runs.size()) { numThreads = runs.size(); }
+	if (numThreads < 1) { numThreads = 1; }
+	std::vector<MeshletJob> jobs(numThreads);
+	for (size_t t = 0; t < numThreads; ++t) {
+		jobs[t].positions = positions.empty() ? NULL : &positions[0];
+		jobs[t].indices = indices.empty() ? NULL : &indices[0];
+		jobs[t].numUnique = numUnique;
+		jobs[t].localIndices = meshlets.indices.empty() ? NULL : &meshlets.indices[0];
+		jobs[t].runs = &runs;
+		jobs[t].firstRun = t;
+		jobs[t].stride = numThreads;
+	}
+	std::vector<std::thread> workers;
+	for (size_t t = 1; t < numThreads; ++t) {
+		workers.push_back(std::thread(BuildMeshletRuns, &jobs[t]));
+	}
+	BuildMeshletRuns(&jobs[0]);
+	for (size_t t = 0; t < workers.size(); ++t) {
+		workers[t].join();
+	}
+
+	// stitch the runs together in facet order
+	for (std::vector<MeshletRun>::const_iterator run = runs.begin(); run != runs.end(); ++run) {
+		const int vertexOffset = (int)meshlets.vertices.size();
+		meshlets.vertices.insert(meshlets.vertices.end(), run->vertices.begin(), run->vertices.end());
+		for (std::vector<Meshlet>::const_iterator meshlet = run->meshlets.begin(); meshlet != run->meshlets.end(); ++meshlet) {
+			meshlets.meshlets.push_back(*meshlet);
+			meshlets.meshlets.back().firstVertex += vertexOffset;
+		}
+	}
+}
+
+// unit normal of a facet and the weight of the normal at each corner
+static void ComputeFacetNormal(const OBJ::VertexList &vertices, const OBJ::Facet &facet, OBJ::NormalWeighting weighting, float *normal, float *weight)
+{
+	float cross[3], dot[3]; // dot[i] is the dot product of the two edges leaving corner i
+#if defined(OBJ_USE_SSE)
+	const __m128 a = _mm_loadu_ps(vertices[facet.vertex[0]]);
+	const __m128 b = _mm_loadu_ps(vertices[facet.vertex[1]]);
+	const __m128 c = _mm_loadu_ps(vertices[facet.vertex[2]]);
+	const __m128 ab = _mm_sub_ps(b, a);
+	const __m128 bc = _mm_sub_ps(c, b);
+	const __m128 ca = _mm_sub_ps(a, c);
+	// ab x -ca, the w lane is 0 since it is ab.w * ca.w - ab.w * ca.w
+	const __m128 n = _mm_sub_ps(
+		_mm_mul_ps(_mm_shuffle_ps(ca, ca, _MM_SHUFFLE(3,0,2,1)), _mm_shuffle_ps(ab, ab, _MM_SHUFFLE(3,1,0,2))),
+		_mm_mul_ps(_mm_shuffle_ps(ca, ca, _MM_SHUFFLE(3,1,0,2)), _mm_shuffle_ps(ab, ab, _MM_SHUFFLE(3,0,2,1)))
+	);
+	float out[4];
+	_mm_storeu_ps(out, n);
+	cross[0] = out[0];
+	cross[1] = out[1];
+	cross[2] = out[2];
+	if (weighting == OBJ::WEIGHT_ANGLE) {
+		// dot products of the two edges leaving each corner
+		const __m128 zero = _mm_setzero_ps();
+		float d0[4], d1[4], d2[4];
+		_mm_storeu_ps(d0, _mm_mul_ps(ab, _mm_sub_ps(zero, ca)));
+		_mm_storeu_ps(d1, _mm_mul_ps(bc, _mm_sub_ps(zero, ab)));
+		_mm_storeu_ps(d2, _mm_mul_ps(ca, _mm_sub_ps(zero, bc)));
+		dot[0] = d0[0] + d0[1] + d0[2];
+		dot[1] = d1[0] + d1[1] + d1[2];
+		dot[2] = d2[0] + d2[1] + d2[2];
+	}
+#else
+	const float *a = vertices[facet.vertex[0]];
+	const float *b = vertices[facet.vertex[1]];
+	const float *c = vertices[facet.vertex[2]];
+	float ab[3], bc[3], ca[3];
+	for (int i = 0; i < 3; ++i) {
+		ab[i] = b[i] - a[i];
+		bc[i] = c[i] - b[i];
+		ca[i] = a[i] - c[i];
+	}
+	cross[0] = ca[1] * ab[2] - ca[2] * ab[1];
+	cross[1] = ca[2] * ab[0] - ca[0] * ab[2];
+	cross[2] = ca[0] * ab[1] - ca[1] * ab[0];
+	if (weighting == OBJ::WEIGHT_ANGLE) {
+		dot[0] = -(ab[0] * ca[0] + ab[1] * ca[1] + ab[2] * ca[2]);
+		dot[1] = -(bc[0] * ab[0] + bc[1] * ab[1] + bc[2] * ab[2]);
+		dot[2] = -(ca[0] * bc[0] + ca[1] * bc[1] + ca[2] * bc[2]);
+	}
+#endif
+	const float length = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]); // twice the area
+	const float scale = (length > 0.0f) ? 1.0f / length : 0.0f;
+	for (int i = 0; i < 3; ++i) {
+		normal[i] = cross[i] * scale;
+	}
+	for (int i = 0; i < 3; ++i) {
+		// the length of the cross product of two edges is the same at every corner, so atan2 gives the angle without normalizing the edges
+		weight[i] = (weighting == OBJ::WEIGHT_ANGLE) ? std::atan2(length, dot[i]) : length;
+	}
+}
+
+// runs in linear time for meshes of bounded valence
+// each corner averages the facets around its vertex, so the work per vertex is the square of its valence when there is a crease angle
+void OBJ::LevelOfDetail::GenerateNormals(NormalWeighting weighting, float creaseAngle, bool replace)
+{
+	std::vector<int> targets; // facets that receive new normals
+	for (size_t i = 0; i < facets.size(); ++i) {
+		Facet &facet = facets[i];
+		if (!replace && facet.normal[0] != Facet::MISSING_INDEX) { continue; }
+		bool valid = true;
+		for (int k = 0; k < 3; ++k) {
+			valid = valid && facet.vertex[k] >= 0 && facet.vertex[k] < (int)vertices.size();
+		}
+		if (valid) {
+			targets.push_back((int)i);
+		} else if (replace) { // the old normals are removed
+			facet.normal[0] = facet.normal[1] = facet.normal[2] = Facet::MISSING_INDEX;
+		}
+	}
+	if (targets.empty()) { return; }
+	if (replace) {
+		normals.clear();
+	}
+
+	std::vector<float3> facetNormals(targets.size());
+	std::vector<float3> cornerWeights(targets.size());
+	for (size_t t = 0; t < targets.size(); ++t) {
+		ComputeFacetNormal(vertices, facets[targets[t]], weighting, facetNormals[t], cornerWeights[t]);
+	}
+
+	// facets that are not smoothed
+	for (size_t t = 0; t < targets.size(); ++t) {
+		Facet &facet = facets[targets[t]];
+		if (facet.smoothingGroup == 0) {
+			facet.normal[0] = facet.normal[1] = facet.normal[2] = (int)normals.size();
+			normals.push_back(facetNormals[t]);
+		}
+	}
+
+	// corners (target * 3 + corner) around each vertex
+	std::vector<int> firstCorner(vertices.size() + 1, 0);
+	for (size_t t = 0; t < targets.size(); ++t) {
+		for (int k = 0; k < 3; ++k) {
+			++firstCorner[facets[targets[t]].vertex[k] + 1];
+		}
+	}
+	for (size_t v = 0; v < vertices.size(); ++v) {
+		firstCorner[v + 1] += firstCorner[v];
+	}
+	std::vector<int> corners(targets.size() * 3);
+	std::vector<int> fill(firstCorner.begin(), firstCorner.end() - 1);
+	for (size_t t = 0; t < targets.size(); ++t) {
+		for (int k = 0; k < 3; ++k) {
+			corners[fill[facets[targets[t]].vertex[k]]++] = (int)t * 3 + k;
+		}
+	}
+
+	const bool crease = creaseAngle < 3.14159265f;
+	const float minCos = std::cos(creaseAngle);
+	std::vector< std::pair<int,int> > shared; // smoothing group and normal index at the current vertex (without crease angle)
+	for (size_t v = 0; v < vertices.size(); ++v) {
+		const int begin = firstCorner[v];
+		const int end = firstCorner[v + 1];
+		const int firstNormal = (int)normals.size(); // normals generated for this vertex
+		shared.clear();
+		for (int c = begin; c < end; ++c) {
+			const int t = corners[c] / 3;
+			Facet &facet = facets[targets[t]];
+			if (facet.smoothingGroup == 0) { continue; }
+
+			int index = Facet::MISSING_INDEX;
+			if (!crease) {
+				for (size_t i = 0; i < shared.size(); ++i) {
+					if (shared[i].first == facet.smoothingGroup) {
+						index = shared[i].second;
+						break;
+					}
+				}
+			}
+			if (index == Facet::MISSING_INDEX) {
+				const float *n = facetNormals[t];
+				float3 sum;
+				sum[X] = sum[Y] = sum[Z] = 0.0f;
+				for (int c2 = begin; c2 < end; ++c2) {
+					const int t2 = corners[c2] / 3;
+					if (facets[targets[t2]].smoothingGroup != facet.smoothingGroup) { continue; }
+					const float *n2 = facetNormals[t2];
+					if (crease && n[X] * n2[X] + n[Y] * n2[Y] + n[Z] * n2[Z] < minCos) { continue; }
+					const float w = cornerWeights[t2][corners[c2] % 3];
+					sum[X] += n2[X] * w;
+					sum[Y] += n2[Y] * w;
+					sum[Z] += n2[Z] * w;
+				}
+				const float length = std::sqrt(sum[X] * sum[X] + sum[Y] * sum[Y] + sum[Z] * sum[Z]);
+				if (length > 0.0f) {
+					sum[X] /= length;
+					sum[Y] /= length;
+					sum[Z] /= length;
+				}
+				// corners with the same set of neighbors end up with identical sums
+				if (crease) {
+					for (int i = firstNormal; i < (int)normals.size(); ++i) {
+						if (normals[i][X] == sum[X] && normals[i][Y] == sum[Y] && normals[i][Z] == sum[Z]) {
+							index = i;
+							break;
+						}
+					}
+				}
+				if (index == Facet::MISSING_INDEX) {
+					index = (int)normals.size();
+					normals.push_back(sum);
+				}
+				if (!crease) {
+					shared.push_back(std::make_pair(facet.smoothingGroup, index));
+				}
+			}
+			facet.normal[corners[c] % 3] = index;
+		}
+	}
+}
+
+int OBJ::FindMaterial(const std::string &materialName) const
+{
+	std::unordered_map<std::string, int>::const_iterator material = materialLookup.find(materialName);
+	return (material != materialLookup.end()) ? material->second : -1;
+}
+
+OBJ::Status OBJ::GetStatus( void ) const
+{
+	if (!errors.empty()) {
+		return OBJ::ERRORS;
+	} else if (!warnings.empty()) {
+		return OBJ::WARNINGS;
+	}
+	return OBJ::OK;
+}
+
+// Transform kernels
+//
+// kernels work on raw arrays so that large LOD:s can be split between threads
+// all kernels take (data, count, params) so that they can be handed to RunKernel
+
+static_assert(sizeof(OBJ::float4) == 4 * sizeof(float), "float4 must be tightly packed");
+static_assert(sizeof(OBJ::float3) == 3 * sizeof(float), "float3 must be tightly packed");
+static_assert(sizeof(OBJ::Facet) == 11 * sizeof(int), "Facet must be tightly packed ints");
+
+// length of the repeating scale pattern, divisible by both 3 and 4 (float3 and float4) as well as the SIMD width
+static const int SCALE_PATTERN_SIZE = 24;
+
+// multiplies data[i] by pattern[i % SCALE_PATTERN_SIZE]
+static void ScaleKernel(float *data, size_t count, const float *pattern)
+{
+	size_t i = 0;
+#if defined(OBJ_USE_AVX)
+	const __m256 p0 = _mm256_loadu_ps(pattern);
+	const __m256 p1 = _mm256_loadu_ps(pattern + 8);
+	const __m256 p2 = _mm256_loadu_ps(pattern + 16);
+	for (; i + SCALE_PATTERN_SIZE <= count; i += SCALE_PATTERN_SIZE) {
+		_mm256_storeu_ps(data + i,      _mm256_mul_ps(_mm256_loadu_ps(data + i),      p0));
+		_mm256_storeu_ps(data + i + 8,  _mm256_mul_ps(_mm256_loadu_ps(data + i + 8),  p1));
+		_mm256_storeu_ps(data + i + 16, _mm256_mul_ps(_mm256_loadu_ps(data + i + 16), p2));
+	}
+#elif defined(OBJ_USE_SSE)
+	__m128 p[SCALE_PATTERN_SIZE / 4];
+	for (int j = 0; j < SCALE_PATTERN_SIZE / 4; ++j) {
+		p[j] = _mm_loadu_ps(pattern + j * 4);
+	}
+	for (; i + SCALE_PATTERN_SIZE <= count; i += SCALE_PATTERN_SIZE) {
+		for (int j = 0; j < SCALE_PATTERN_SIZE / 4; ++j) {
+			_mm_storeu_ps(data + i + j * 4, _mm_mul_ps(_mm_loadu_ps(data + i + j * 4), p[j]));
+		}
+	}
+#endif
+	for (; i < count; ++i) {
+		data[i] *= pattern[i % SCALE_PATTERN_SIZE];
+	}
+}
+
+// multiplies positions by a 4x4 row major matrix
+static void TransformVertexKernel(OBJ::float4 *vertices, size_t count, const float *m)
+{
+#if defined(OBJ_USE_SSE)
+	const __m128 c0 = _mm_setr_ps(m[0], m[4], m[8],  m[12]);
+	const __m128 c1 = _mm_setr_ps(m[1], m[5], m[9],  m[13]);
+	const __m128 c2 = _mm_setr_ps(m[2], m[6], m[10], m[14]);
+	const __m128 c3 = _mm_setr_ps(m[3], m[7], m[11], m[15]);
+	for (size_t i = 0; i < count; ++i) {
+		float *v = vertices[i];
+		const __m128 x = _mm_loadu_ps(v);
+		__m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(x, x, _MM_SHUFFLE(0,0,0,0)));
+		r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(x, x, _MM_SHUFFLE(1,1,1,1))));
+		r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(x, x, _MM_SHUFFLE(2,2,2,2))));
+		r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(x, x, _MM_SHUFFLE(3,3,3,3))));
+		_mm_storeu_ps(v, r);
+	}
+#else
+	for (size_t i = 0; i < count; ++i) {
+		float *v = vertices[i];
+		const float x = v[0], y = v[1], z = v[2], w = v[3];
+		for (int row = 0; row < 4; ++row) {
+			v[row] = m[row*4] * x + m[row*4+1] * y + m[row*4+2] * z + m[row*4+3] * w;
+		}
+	}
+#endif
+}
+
+// multiplies normals by a 3x3 row major matrix
+static void TransformNormalKernel(OBJ::float3 *normals, size_t count, const float *m)
+{
+	size_t i = 0;
+#if defined(OBJ_USE_SSE)
+	const __m128 c0 = _mm_setr_ps(m[0], m[3], m[6], 0.0f);
+	const __m128 c1 = _mm_setr_ps(m[1], m[4], m[7], 0.0f);
+	const __m128 c2 = _mm_setr_ps(m[2], m[5], m[8], 0.0f);
+	// loads four floats, so the last normal is left for the scalar loop to stay inside the array
+	for (; i + 1 < count; ++i) {
+		float *n = normals[i];
+		const __m128 x = _mm_loadu_ps(n);
+		__m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(x, x, _MM_SHUFFLE(0,0,0,0)));
+		r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(x, x, _MM_SHUFFLE(1,1,1,1))));
+		r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(x, x, _MM_SHUFFLE(2,2,2,2))));
+		_mm_storel_pi((__m64*)n, r);
+		_mm_store_ss(n + 2, _mm_movehl_ps(r, r));
+	}
+#endif
+	for (; i < count; ++i) {
+		float *n = normals[i];
+		const float x = n[0], y = n[1], z = n[2];
+		for (int row = 0; row < 3; ++row) {
+			n[row] = m[row*3] * x + m[row*3+1] * y + m[row*3+2] * z;
+		}
+	}
+}
+
+// swaps the first and last corner of each facet
+static void SwapWindingKernel(OBJ::Facet *facets, size_t count, const float*)
+{
+	size_t i = 0;
+#if defined(OBJ_USE_SSE)
+	// the vertex, texCoord and normal triples are loaded as overlapping 4-int registers (the 4th int is kept as is)
+	// all three are loaded before storing since the stores overwrite the 4th int of the previous register
+	for (; i < count; ++i) {
+		int *f = (int*)&facets[i];
+		const __m128i v = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)f),       _MM_SHUFFLE(3,0,1,2));
+		const __m128i t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(f + 3)), _MM_SHUFFLE(3,0,1,2));
+		const __m128i n = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)(f + 6)), _MM_SHUFFLE(3,0,1,2));
+		_mm_storeu_si128((__m128i*)f, v);
+		_mm_storeu_si128((__m128i*)(f + 3), t);
+		_mm_storeu_si128((__m128i*)(f + 6), n);
+	}
+#endif
+	for (; i < count; ++i) {
+		std::swap(facets[i].vertex[0], facets[i].vertex[2]);
+		std::swap(facets[i].texCoord[0], facets[i].texCoord[2]);
+		std::swap(facets[i].normal[0], facets[i].normal[2]);
+	}
+}
+
+// splits large arrays between threads, slices start at multiples of granularity
+template < typename type_t >
+static void RunKernel(void (*kernel)(type_t*, size_t, const float*), type_t *data, size_t count, const float *params, size_t granularity = 1)
+{
+	static const size_t MIN_SLICE = 1 << 16; // smaller slices are not worth the thread start up
+	const size_t numThreads = (count >= MIN_SLICE * 2) ? std::min((size_t)std::thread::hardware_concurrency(), count / MIN_SLICE) : 1;
+	if (numThreads <= 1) {
+		kernel(data, count, params);
+		return;
+	}
+	const size_t slice = (count / numThreads + granularity - 1) / granularity * granularity;
+	std::vector<std::thread> threads;
+	for (size_t start = slice; start < count; start += slice) {
+		threads.push_back(std::thread(kernel, data + start, std::min(slice, count - start), params));
+	}
+	kernel(data, std::min(slice, count), params);
+	for (size_t i = 0; i < threads.size(); ++i) {
+		threads[i].join();
+	}
+}
+
+// multiplies each component of a float3/float4 list by scale
+template < typename list_t >
+static void ScaleComponents(list_t &list, const float *scale)
+{
+	static const int components = sizeof(typename list_t::value_type) / sizeof(float);
+	if (list.empty()) { return; }
+	float pattern[SCALE_PATTERN_SIZE];
+	for (int i = 0; i < SCALE_PATTERN_SIZE; ++i) {
+		pattern[i] = scale[i % components];
+	}
+	RunKernel(ScaleKernel, (float*)list[0], list.size() * components, pattern, SCALE_PATTERN_SIZE);
+}
+
+static void SwapWinding(OBJ::FacetList &facets)
+{
+	if (facets.empty()) { return; }
+	RunKernel(SwapWindingKernel, &facets[0], facets.size(), NULL);
+}
+
+void OBJ::Reverse( void )
+{
+	// models are made for looking down the negative z axis
+	// engine looks down the positive z axis
+	// 1. reverse triangle winding order
+	// 2. negate model's z coordinates (will this muck with winding order, i.e. do I need to change BOTH winding order and z coordinates - if no, change z coordinates)
+	// 3. negate model's normals' z coordinates
+	const float vertexScale[4] = { 1.0f, 1.0f, -1.0f, 1.0f };
+	const float normalScale[3] = { -1.0f, -1.0f, -1.0f };
+	for (LODList::iterator lod = levelOfDetail.begin(); lod != levelOfDetail.end(); ++lod) {
+		SwapWinding(lod->facets);
+		ScaleComponents(lod->vertices, vertexScale);
+		ScaleComponents(lod->normals, normalScale);
+	}
+}
+
+void OBJ::Transform(const float *matrix)
+{
+	// normals use the inverse transpose of the upper 3x3, i.e. its cofactor matrix divided by the determinant
+	const float *m = matrix;
+	float normalMatrix[9] = {
+		m[5]*m[10] - m[6]*m[9], m[6]*m[8] - m[4]*m[10], m[4]*m[9] - m[5]*m[8],
+		m[2]*m[9] - m[1]*m[10], m[0]*m[10] - m[2]*m[8], m[1]*m[8] - m[0]*m[9],
+		m[1]*m[6] - m[2]*m[5],  m[2]*m[4] - m[0]*m[6],  m[0]*m[5] - m[1]*m[4]
+	};
+	const float det = m[0] * normalMatrix[0] + m[1] * normalMatrix[1] + m[2] * normalMatrix[2];
+	if (det != 0.0f) {
+		for (int i = 0; i < 9; ++i) {
+			normalMatrix[i] /= det;
+		}
+	}
+	for (LODList::iterator lod = levelOfDetail.begin(); lod != levelOfDetail.end(); ++lod) {
+		if (!lod->vertices.empty()) {
+			RunKernel(TransformVertexKernel, &lod->vertices[0], lod->vertices.size(), matrix);
+		}
+		if (!lod->normals.empty()) {
+			RunKernel(TransformNormalKernel, &lod->normals[0], lod->normals.size(), normalMatrix);
+		}
+		if (det < 0.0f) {
+			SwapWinding(lod->facets);
+		}
+	}
+}
+
+void OBJ::Scale(float scale)
+{
+	// a negative scale is a point reflection, normals point the other way and winding is swapped
+	const float vertexScale[4] = { scale, scale, scale, 1.0f };
+	const float normalScale[3] = { -1.0f, -1.0f, -1.0f };
+	for (LODList::iterator lod = levelOfDetail.begin(); lod != levelOfDetail.end(); ++lod) {
+		ScaleComponents(lod->vertices, vertexScale);
+		if (scale < 0.0f) {
+			ScaleComponents(lod->normals, normalScale);
+			SwapWinding(lod->facets);
+		}
+	}
+}
+
+void OBJ::FlipAxis(int axis)
+{
+	if (axis < X || axis > Z) {
+		return;
+	}
+	float vertexScale[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	float normalScale[3] = { 1.0f, 1.0f, 1.0f };
+	vertexScale[axis] = -1.0f;
+	normalScale[axis] = -1.0f;
+	for (LODList::iterator lod = levelOfDetail.begin(); lod != levelOfDetail.end(); ++lod) {
+		SwapWinding(lod->facets);
+		ScaleComponents(lod->vertices, vertexScale);
+		ScaleComponents(lod->normals, normalScale);
+	}
+}
+
+// Binary cache
+//
+// header: magic, version
+// strings: fileName, name, shadowModel
+// string lists: libraries, errors, warnings
+// materials: count, per material all colors, values, maps and valid map flags
+// LOD:s: count, per LOD levelOfDetail, vertices, texCoords, normals, facets, groups, batches
+// groups: count, per group name and facet ranges
+//
+// strings are stored as length + characters, arrays as count + padding up to
+// the next multiple of Binary::ALIGNMENT + elements in memory layout
+// everything is stored in native byte order
+
+class BinaryWriter
+{
+private:
+	std::ofstream out;
+	size_t offset;
+public:
+	explicit BinaryWriter(const std::string &filename) : out(filename.c_str(), std::ios::binary | std::ios::trunc), offset(0) {}
+	bool IsGood( void ) const { return out.good(); }
+	bool Close( void ) { out.close(); return !out.fail(); }
+	void WriteBytes(const void *data, size_t size)
+	{
+		out.write((const char*)data, (std::streamsize)size);
+		offset += size;
+	}
+	void WriteUInt(unsigned int value) { WriteBytes(&value, sizeof(value)); }
+	void WriteInt(int value) { WriteBytes(&value, sizeof(value)); }
+	void WriteFloat(float value) { WriteBytes(&value, sizeof(value)); }
+	void WriteString(const std::string &str)
+	{
+		WriteUInt((unsigned int)str.size());
+		WriteBytes(str.data(), str.size());
+	}
+	void WriteStrings(const std::vector<std::string> &strs)
+	{
+		WriteUInt((unsigned int)strs.size());
+		for (std::vector<std::string>::const_iterator str = strs.begin(); str != strs.end(); ++str) {
+			WriteString(*str);
+		}
+	}
+	void WriteStrings(const std::list<std::string> &strs)
+	{
+		WriteUInt((unsigned int)strs.size());
+		for (std::list<std::string>::const_iterator str = strs.begin(); str != strs.end(); ++str) {
+			WriteString(*str);
+		}
+	}
+	template < typename type_t >
+	void WriteArray(const std::vector<type_t> &array)
+	{
+		static const char padding[OBJ::Binary::ALIGNMENT] = { 0 };
+		WriteUInt((unsigned int)array.size());
+		WriteBytes(padding, (OBJ::Binary::ALIGNMENT - offset % OBJ::Binary::ALIGNMENT) % OBJ::Binary::ALIGNMENT);
+		if (!array.empty()) {
+			WriteBytes(&array[0], array.size() * sizeof(type_t));
+		}
+	}
+};
+
+class BinaryReader
+{
+private:
+	std::ifstream in;
+	size_t size;
+	size_t offset;
+public:
+	explicit BinaryReader(const std::string &filename) : in(filename.c_str(), std::ios::binary), size(0), offset(0)
+	{
+		if (in.is_open()) {
+			in.seekg(0, std::ios::end);
+			size = (size_t)in.tellg();
+			in.seekg(0, std::ios::beg);
+		}
+	}
+	bool IsEnd( void ) const { return offset == size; }
+	bool ReadBytes(void *data, size_t count)
+	{
+		if (count > size - offset) { return false; } // also guards against allocating garbage sizes
+		in.read((char*)data, (std::streamsize)count);
+		offset += count;
+		return in.good();
+	}
+	bool ReadUInt(unsigned int &value) { return ReadBytes(&value, sizeof(value)); }
+	bool ReadInt(int &value) { return ReadBytes(&value, sizeof(value)); }
+	bool ReadFloat(float &value) { return ReadBytes(&value, sizeof(value)); }
+	bool ReadString(std::string &str)
+	{
+		unsigned int length;
+		if (!ReadUInt(length) || length > size - offset) { return false; }
+		str.resize(length);
+		return length == 0 || ReadBytes(&str[0], length);
+	}
+	template < typename list_t >
+	bool ReadStrings(list_t &strs)
+	{
+		unsigned int count;
+		if (!ReadUInt(count)) { return false; }
+		std::string str;
+		for (unsigned int i = 0; i < count; ++i) {
+			if (!ReadString(str)) { return false; }
+			strs.push_back(str);
+		}
+		return true;
+	}
+	template < typename type_t >
+	bool ReadArray(std::vector<type_t> &array)
+	{
+		unsigned int count;
+		if (!ReadUInt(count)) { return false; }
+		const size_t padding = (OBJ::Binary::ALIGNMENT - offset % OBJ::Binary::ALIGNMENT) % OBJ::Binary::ALIGNMENT;
+		if (padding > size - offset || count > (size - offset - padding) / sizeof(type_t)) { return false; }
+		in.seekg((std::streamoff)padding, std::ios::cur);
+		offset += padding;
+		array.resize(count);
+		return count == 0 || ReadBytes(&array[0], count * sizeof(type_t));
+	}
+};
+
+static bool GetModifiedTime(const std::string &filename, time_t &time)
+{
+	struct stat info;
+	if (stat(filename.c_str(), &info) != 0) {
+		return false;
+	}
+	time = info.st_mtime;
+	return true;
+}
+
+// the indices in a cache are checked, a damaged cache must not index out of range
+
+static bool IsValidIndex(int index, size_t count)
+{
+	return index == OBJ::Facet::MISSING_INDEX || (index >= 0 && (size_t)index < count);
+}
+
+template < typename facets_t >
+static bool IsValidFacets(const facets_t &facets, size_t numVertices, size_t numTexCoords, size_t numNormals, size_t numMaterials)
+{
+	for (size_t i = 0; i < facets.size(); ++i) {
+		const OBJ::Facet &facet = facets[i];
+		for (int j = 0; j < 3; ++j) {
+			if (!IsValidIndex(facet.vertex[j], numVertices) || !IsValidIndex(facet.texCoord[j], numTexCoords) || !IsValidIndex(facet.normal[j], numNormals)) {
+				return false;
+			}
+		}
+		if (facet.material < 0 || (size_t)facet.material >= numMaterials) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template < typename ranges_t >
+static bool IsValidRanges(const ranges_t &ranges, size_t numFacets)
+{
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		if (ranges[i].begin < 0 || ranges[i].begin >= ranges[i].end || (size_t)ranges[i].end > numFacets) { // ranges are never empty (an empty range would still be iterated)
+			return false;
+		}
+	}
+	return true;
+}
+
+template < typename batches_t >
+static bool IsValidBatches(const batches_t &batches, size_t numFacets, size_t numMaterials)
+{
+	for (size_t i = 0; i < batches.size(); ++i) {
+		const OBJ::Batch &batch = batches[i];
+		if (batch.material < 0 || (size_t)batch.material >= numMaterials || batch.firstFacet < 0 || batch.facetCount < 0 || (size_t)batch.firstFacet + (size_t)batch.facetCount > numFacets) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// a file next to filename that is renamed to filename once it has been written (unique per process and call)
+static std::string GetTemporaryName(const std::string &filename)
+{
+	static std::atomic<unsigned int> counter(0);
+	std::ostringstream name;
+	name << filename << ".tmp";
+#ifdef OBJ_USE_MMAP
+	name << getpid() << '.';
+#endif
+	name << counter++;
+	return name.str();
+}
+
+// the cache is written to a temporary file that then replaces it, so other loaders never
+// see it half written (and an OBJView that maps the old file keeps its pages)
+bool OBJ::SaveBinary(const std::string &filename) const
+{
+	const std::string temporaryName = GetTemporaryName(filename);
+	BinaryWriter out(temporaryName);
+	if (!out.IsGood()) {
+		return false;
+	}
+
+	out.WriteUInt(Binary::MAGIC);
+	out.WriteUInt(Binary::VERSION);
+	out.WriteString(fileName);
+	out.WriteString(name);
+	out.WriteString(shadowModel);
+	out.WriteStrings(libraries);
+	out.WriteStrings(errors);
+	out.WriteStrings(warnings);
+
+	out.WriteUInt((unsigned int)materials.size());
+	for (MaterialList::const_iterator material = materials.begin(); material != materials.end(); ++material) {
+		out.WriteString(material->name);
+		out.WriteBytes((const float*)material->ambient, sizeof(float4));
+		out.WriteBytes((const float*)material->diffuse, sizeof(float4));
+		out.WriteBytes((const float*)material->specular, sizeof(float4));
+		out.WriteBytes((const float*)material->emissive, sizeof(float4));
+		out.WriteBytes((const float*)material->transmission, sizeof(float4));
+		out.WriteFloat(material->alpha);
+		out.WriteFloat(material->dissolve);
+		out.WriteFloat(material->shininess);
+		out.WriteFloat(material->opticalDensity);
+		out.WriteFloat(material->sharpness);
+		out.WriteInt(material->illumination);
+		out.WriteString(material->ambientMap);
+		out.WriteString(material->diffuseMap);
+		out.WriteString(material->specularMap);
+		out.WriteString(material->emissiveMap);
+		out.WriteString(material->transmissionMap);
+		out.WriteString(material->shininessMap);
+		out.WriteString(material->alphaMap);
+		out.WriteString(material->dissolveMap);
+		out.WriteString(material->displacementMap);
+		out.WriteString(material->detailMap);
+		out.WriteString(material->bumpMap);
+		out.WriteUInt(material->validMaps);
+	}
+
+	out.WriteUInt((unsigned int)levelOfDetail.size());
+	for (LODList::const_iterator lod = levelOfDetail.begin(); lod != levelOfDetail.end(); ++lod) {
+		out.WriteInt(lod->levelOfDetail);
+		out.WriteArray(lod->vertices);
+		out.WriteArray(lod->texCoords);
+		out.WriteArray(lod->normals);
+		out.WriteArray(lod->facets);
+		out.WriteUInt((unsigned int)lod->groups.size());
+		for (GroupList::const_iterator group = lod->groups.begin(); group != lod->groups.end(); ++group) {
+			out.WriteString(group->name);
+			out.WriteArray(group->facets.GetRanges());
+		}
+		out.WriteArray(lod->batches);
+	}
+
+	bool written = out.Close();
+	if (written) {
+#if defined(_WIN32)
+		std::remove(filename.c_str()); // rename does not replace existing files
+#endif
+		written = (std::rename(temporaryName.c_str(), filename.c_str()) == 0);
+	}
+	if (!written) {
+		std::remove(temporaryName.c_str());
+	}
+	return written;
+}
+
+// sourceFile is used to check if the cache is out of date (no check if empty)
+bool OBJ::ReadBinary(const std::string &filename, const std::string &sourceFile)
+{
+	time_t binaryTime = 0;
+	if (!sourceFile.empty() && !GetModifiedTime(filename, binaryTime)) {
+		return false;
+	}
+
+	BinaryReader in(filename);
+	unsigned int magic, version;
+	if (!in.ReadUInt(magic) || magic != Binary::MAGIC || !in.ReadUInt(version) || version != Binary::VERSION) {
+		return false;
+	}
+	if (!in.ReadString(fileName) || !in.ReadString(name) || !in.ReadString(shadowModel) || !in.ReadStrings(libraries)) {
+		return false;
+	}
+
+	if (!sourceFile.empty()) {
+		// the cache has to be newer than everything it was built from
+		time_t sourceTime;
+		if (fileName != sourceFile || !GetModifiedTime(sourceFile, sourceTime) || sourceTime >= binaryTime) {
+			return false;
+		}
+		for (std::vector<std::string>::const_iterator library = libraries.begin(); library != libraries.end(); ++library) {
+			if (!GetModifiedTime(*library, sourceTime) || sourceTime >= binaryTime) {
+				return false;
+			}
+		}
+	}
+
+	if (!in.ReadStrings(errors) || !in.ReadStrings(warnings)) {
+		return false;
+	}
+
+	unsigned int count;
+	if (!in.ReadUInt(count)) {
+		return false;
+	}
+	std::shared_ptr<MaterialTable> table(new MaterialTable); // not shared with other OBJ:s
+	for (unsigned int i = 0; i < count; ++i) {
+		table->materials.push_back(Material());
+		Material &material = table->materials.back();
+		bool valid =
+			in.ReadString(material.name) &&
+			in.ReadBytes((float*)material.ambient, sizeof(float4)) &&
+			in.ReadBytes((float*)material.diffuse, sizeof(float4)) &&
+			in.ReadBytes((float*)material.specular, sizeof(float4)) &&
+			in.ReadBytes((float*)material.emissive, sizeof(float4)) &&
+			in.ReadBytes((float*)material.transmission, sizeof(float4)) &&
+			in.ReadFloat(material.alpha) &&
+			in.ReadFloat(material.dissolve) &&
+			in.ReadFloat(material.shininess) &&
+			in.ReadFloat(material.opticalDensity) &&
+			in.ReadFloat(material.sharpness) &&
+			in.ReadInt(material.illumination) &&
+			in.ReadString(material.ambientMap) &&
+			in.ReadString(material.diffuseMap) &&
+			in.ReadString(material.specularMap) &&
+			in.ReadString(material.emissiveMap) &&
+			in.ReadString(material.transmissionMap) &&
+			in.ReadString(material.shininessMap) &&
+			in.ReadString(material.alphaMap) &&
+			in.ReadString(material.dissolveMap) &&
+			in.ReadString(material.displacementMap) &&
+			in.ReadString(material.detailMap) &&
+			in.ReadString(material.bumpMap) &&
+			in.ReadUInt(material.validMaps);
+		if (!valid) {
+			return false;
+		}
+		materialLookup.insert(std::make_pair(material.name, (int)i));
+	}
+	for (unsigned int i = 0; i < count; ++i) {
+		materials.push_back(table, i);
+	}
+
+	if (!in.ReadUInt(count)) {
+		return false;
+	}
+	std::string groupName;
+	FacetIndexList::RangeList ranges;
+	for (unsigned int i = 0; i < count; ++i) {
+		levelOfDetail.push_back(LevelOfDetail());
+		LevelOfDetail &lod = levelOfDetail.back();
+		unsigned int numGroups;
+		if (!in.ReadInt(lod.levelOfDetail) || !in.ReadArray(lod.vertices) || !in.ReadArray(lod.texCoords) || !in.ReadArray(lod.normals) || !in.ReadArray(lod.facets) || !in.ReadUInt(numGroups)) {
+			return false;
+		}
+		if (!IsValidFacets(lod.facets, lod.vertices.size(), lod.texCoords.size(), lod.normals.size(), materials.size())) {
+			return false;
+		}
+		for (unsigned int j = 0; j < numGroups; ++j) {
+			if (!in.ReadString(groupName) || !in.ReadArray(ranges) || !IsValidRanges(ranges, lod.facets.size())) {
+				return false;
+			}
+			FacetIndexList &facets = lod.groups[lod.AddGroup(groupName)].facets;
+			for (FacetIndexList::RangeList::const_iterator range = ranges.begin(); range != ranges.end(); ++range) {
+				facets.push_back(*range);
+			}
+		}
+		if (!in.ReadArray(lod.batches) || !IsValidBatches(lod.batches, lod.facets.size(), materials.size())) {
+			return false;
+		}
+	}
+	return in.IsEnd();
+}
+
+bool OBJ::LoadBinary(const std::string &filename)
+{
+	Clear();
+	if (!ReadBinary(filename, std::string())) {
+		Clear();
+		errors.push_back("\"" + filename + "\": File is not a valid binary cache");
+		return false;
+	}
+	return true;
+}
+
+// leaves only an error if the load was cancelled, returns true if it was
+bool OBJ::CheckCancelled(const std::string &filename, const Progress *progress)
+{
+	if (progress == NULL || !progress->IsCancelled()) {
+		return false;
+	}
+	Clear();
+	fileName = filename;
+	errors.push_back("Loading was cancelled");
+	return true;
+}
+
+void OBJ::Clear( void )
+{
+	fileName.clear();
+	name.clear();
+	shadowModel.clear();
+	levelOfDetail.clear();
+	materials.clear();
+	materialLookup.clear();
+	libraries.clear();
+	errors.clear();
+	warnings.clear();
+}
+
+void OBJ::DumpErrors(std::ostream &out, const unsigned int MaxErrors) const
+{
+	size_t n = 0;
+	for (std::list<std::string>::const_iterator i = errors.begin(); i != errors.end(); ++i){
+		out << *i << std::endl;
+		if (++n == MaxErrors) {
+			out << "<< " << errors.size() - n << " more error(s) >>" << std::endl;
+			break;
+		}
+	}
+	out << "--" << errors.size() << " error(s)--" << std::endl;
+}
+
+void OBJ::DumpWarnings(std::ostream &out, const unsigned int MaxWarnings) const
+{
+	size_t n = 0;
+	for (std::list<std::string>::const_iterator i = warnings.begin(); i != warnings.end(); ++i){
+		out << *i << std::endl;
+		if (++n == MaxWarnings) {
+			out << "<< " << warnings.size() - n << " more warning(s) >>" << std::endl;
+			break;
 		}
 	}
 	out << "--" << warnings.size() << " warning(s)--" << std::endl;
 }
+
+// OBJView
+//
+// decoding never reads past 'end' and returns NULL if it would, so all
+// records are checked once when the view is opened and can then be
+// decoded without checks while iterating
+
+static const char *ViewBytes(const char *at, const char *end, void *out, size_t size)
+{
+	if (at == NULL || (size_t)(end - at) < size) {
+		return NULL;
+	}
+	memcpy(out, at, size); // values are not necessarily aligned
+	return at + size;
+}
+
+static const char *ViewUInt(const char *at, const char *end, unsigned int &out)
+{
+	return ViewBytes(at, end, &out, sizeof(out));
+}
+
+static const char *ViewString(const char *at, const char *end, OBJView::String &out)
+{
+	unsigned int length;
+	at = ViewUInt(at, end, length);
+	if (at == NULL || (size_t)(end - at) < length) {
+		return NULL;
+	}
+	out.begin = at;
+	out.end = at + length;
+	return out.end;
+}
+
+template < typename type_t >
+static const char *ViewArray(const char *base, const char *at, const char *end, OBJView::Array<type_t> &out)
+{
+	unsigned int count;
+	at = ViewUInt(at, end, count);
+	if (at == NULL) {
+		return NULL;
+	}
+	const size_t padding = (OBJ::Binary::ALIGNMENT - (size_t)(at - base) % OBJ::Binary::ALIGNMENT) % OBJ::Binary::ALIGNMENT;
+	if ((size_t)(end - at) < padding || count > (size_t)(end - at - padding) / sizeof(type_t)) {
+		return NULL;
+	}
+	at += padding;
+	out = OBJView::Array<type_t>((const type_t*)at, count);
+	return at + count * sizeof(type_t);
+}
+
+const char *OBJView::Decode(const char *base, const char *at, const char *end, Group &out)
+{
+	at = ViewString(at, end, out.name);
+	return ViewArray(base, at, end, out.facets);
+}
+
+const char *OBJView::Decode(const char *, const char *at, const char *end, Material &out)
+{
+	at = ViewString(at, end, out.name);
+	at = ViewBytes(at, end, (float*)out.ambient, sizeof(OBJ::float4));
+	at = ViewBytes(at, end, (float*)out.diffuse, sizeof(OBJ::float4));
+	at = ViewBytes(at, end, (float*)out.specular, sizeof(OBJ::float4));
+	at = ViewBytes(at, end, (float*)out.emissive, sizeof(OBJ::float4));
+	at = ViewBytes(at, end, (float*)out.transmission, sizeof(OBJ::float4));
+	at = ViewBytes(at, end, &out.alpha, sizeof(float));
+	at = ViewBytes(at, end, &out.dissolve, sizeof(float));
+	at = ViewBytes(at, end, &out.shininess, sizeof(float));
+	at = ViewBytes(at, end, &out.opticalDensity, sizeof(float));
+	at = ViewBytes(at, end, &out.sharpness, sizeof(float));
+	at = ViewBytes(at, end, &out.illumination, sizeof(int));
+	at = ViewString(at, end, out.ambientMap);
+	at = ViewString(at, end, out.diffuseMap);
+	at = ViewString(at, end, out.specularMap);
+	at = ViewString(at, end, out.emissiveMap);
+	at = ViewString(at, end, out.transmissionMap);
+	at = ViewString(at, end, out.shininessMap);
+	at = ViewString(at, end, out.alphaMap);
+	at = ViewString(at, end, out.dissolveMap);
+	at = ViewString(at, end, out.displacementMap);
+	at = ViewString(at, end, out.detailMap);
+	at = ViewString(at, end, out.bumpMap);
+	return ViewUInt(at, end, out.validMaps);
+}
+
+const char *OBJView::Decode(const char *base, const char *at, const char *end, LevelOfDetail &out)
+{
+	at = ViewBytes(at, end, &out.levelOfDetail, sizeof(int));
+	at = ViewArray(base, at, end, out.vertices);
+	at = ViewArray(base, at, end, out.texCoords);
+	at = ViewArray(base, at, end, out.normals);
+	at = ViewArray(base, at, end, out.facets);
+	unsigned int numGroups = 0;
+	at = ViewUInt(at, end, numGroups);
+	if (at == NULL) {
+		return NULL;
+	}
+	const char *first = at;
+	Group group;
+	for (unsigned int i = 0; i < numGroups && at != NULL; ++i) { // groups have to be skipped to find the batches
+		at = Decode(base, at, end, group);
+	}
+	out.groups = GroupList(base, first, end, numGroups);
+	return ViewArray(base, at, end, out.batches);
+}
+
+bool OBJView::Validate( void )
+{
+	unsigned int magic, version, count;
+	const char *at = ViewUInt(mapBegin, mapEnd, magic);
+	at = ViewUInt(at, mapEnd, version);
+	if (at == NULL || magic != OBJ::Binary::MAGIC || version != OBJ::Binary::VERSION) {
+		return false;
+	}
+	at = ViewString(at, mapEnd, fileName);
+	at = ViewString(at, mapEnd, name);
+	at = ViewString(at, mapEnd, shadowModel);
+	
+	// libraries, errors and warnings are not part of the view
+	String skip;
+	for (int list = 0; list < 3; ++list) {
+		at = ViewUInt(at, mapEnd, count);
+		for (unsigned int i = 0; i < count && at != NULL; ++i) {
+			at = ViewString(at, mapEnd, skip);
+		}
+	}
+
+	at = ViewUInt(at, mapEnd, count);
+	const char *first = at;
+	Material material;
+	for (unsigned int i = 0; i < count && at != NULL; ++i) {
+		at = Decode(mapBegin, at, mapEnd, material);
+	}
+	materials = MaterialList(mapBegin, first, mapEnd, count);
+
+	at = ViewUInt(at, mapEnd, count);
+	first = at;
+	LevelOfDetail lod;
+	for (unsigned int i = 0; i < count && at != NULL; ++i) {
+		at = Decode(mapBegin, at, mapEnd, lod);
+		if (at == NULL) {
+			break;
+		}
+		if (!IsValidFacets(lod.facets, lod.vertices.size(), lod.texCoords.size(), lod.normals.size(), materials.size()) || !IsValidBatches(lod.batches, lod.facets.size(), materials.size())) {
+			return false;
+		}
+		for (GroupList::const_iterator group = lod.groups.begin(); group != lod.groups.end(); ++group) {
+			if (!IsValidRanges(group->facets, lod.facets.size())) {
+				return false;
+			}
+		}
+	}
+	levelOfDetail = LODList(mapBegin, first, mapEnd, count);
+
+	return at == mapEnd;
+}
+
+void OBJView::Close( void )
+{
+	if (mapBegin != NULL) {
+#ifdef OBJ_USE_MMAP
+		if (isMapped) {
+			munmap((void*)mapBegin, (size_t)(mapEnd - mapBegin));
+		} else {
+			delete [] mapBegin;
+		}
+#else
+		delete [] mapBegin;
+#endif
+	}
+	mapBegin = NULL;
+	mapEnd = NULL;
+	isMapped = false;
+	fileName = name = shadowModel = String();
+	materials = MaterialList();
+	levelOfDetail = LODList();
+}
+
+OBJView::OBJView(const std::string &filename) :
+	mapBegin(NULL),
+	mapEnd(NULL),
+	isMapped(false),
+	fileName(),
+	name(),
+	shadowModel(),
+	materials(),
+	levelOfDetail()
+{
+#ifdef OBJ_USE_MMAP
+	// the mapping is shared, so the pages are in memory only once no matter how many processes view the file
+	const int fd = open(filename.c_str(), O_RDONLY);
+	if (fd != -1) {
+		struct stat info;
+		if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+			const size_t size = (size_t)info.st_size;
+			void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+			if (map != MAP_FAILED) {
+				mapBegin = (const char*)map;
+				mapEnd = mapBegin + size;
+				isMapped = true;
+			}
+		}
+		close(fd);
+	}
+#endif
+	if (mapBegin == NULL) { // no mapping available, read the file instead
+		std::ifstream fin(filename.c_str(), std::ios::binary);
+		fin.seekg(0, std::ios::end);
+		const std::streamoff size = fin.tellg();
+		if (fin.good() && size > 0) {
+			char *buffer = new char[(size_t)size];
+			fin.seekg(0, std::ios::beg);
+			if (fin.read(buffer, size)) {
+				mapBegin = buffer;
+				mapEnd = buffer + size;
+			} else {
+				delete [] buffer;
+			}
+		}
+	}
+	if (mapBegin != NULL && !Validate()) {
+		Close();
+	}
+}
+
+// OBJBatchLoader
+
+struct BatchJob
+{
+	const std::vector<std::string> *filenames;
+	OBJ::Options options;
+	OBJBatchLoader::Handler *handler; // NULL when loading into objs
+	std::vector<OBJ> *objs;
+	bool ordered;
+	size_t maxPending;
+	std::mutex lock; // guards everything below
+	std::condition_variable delivered; // signaled when a file has been passed on to handler
+	size_t next; // next file to load
+	size_t numDelivered; // files that have been passed on to handler (ordered only)
+	bool delivering; // a thread is passing files on to handler (ordered only)
+	std::vector<OBJ*> ready; // loaded files waiting for earlier files (ordered only)
+	std::mutex handlerLock; // serializes calls to handler (unordered only)
+	BatchJob( void ) : filenames(NULL), options(), handler(NULL), objs(NULL), ordered(false), maxPending(1), next(0), numDelivered(0), delivering(false) {}
+};
+
+// loads files until there are none left
+static void RunBatchJob(BatchJob *job)
+{
+	const size_t count = job->filenames->size();
+	std::unique_lock<std::mutex> lock(job->lock);
+	for (;;) {
+		// do not load too far ahead of the next file to pass on
+		while (job->ordered && job->next < count && job->next - job->numDelivered >= job->maxPending) {
+			job->delivered.wait(lock);
+		}
+		if (job->next >= count) {
+			break;
+		}
+		const size_t index = job->next++;
+		lock.unlock();
+
+		if (job->handler == NULL) {
+			(*job->objs)[index] = OBJ((*job->filenames)[index], job->options);
+		} else if (!job->ordered) {
+			OBJ obj((*job->filenames)[index], job->options);
+			std::lock_guard<std::mutex> call(job->handlerLock);
+			job->handler->OnLoad(index, obj);
+		} else {
+			OBJ *obj = new OBJ((*job->filenames)[index], job->options);
+			lock.lock();
+			job->ready[index] = obj;
+			// the first thread to get here passes on files for as long as the next one is ready
+			// (other threads only leave their files in ready)
+			if (!job->delivering) {
+				job->delivering = true;
+				while (job->numDelivered < count && job->ready[job->numDelivered] != NULL) {
+					const size_t readyIndex = job->numDelivered;
+					OBJ *readyObj = job->ready[readyIndex];
+					job->ready[readyIndex] = NULL;
+					lock.unlock();
+					job->handler->OnLoad(readyIndex, *readyObj);
+					delete readyObj;
+					lock.lock();
+					++job->numDelivered;
+					job->delivered.notify_all();
+				}
+				job->delivering = false;
+			}
+			continue;
+		}
+		lock.lock();
+	}
+}
+
+static void RunBatch(BatchJob &job, int threads)
+{
+	size_t numThreads = (threads > 0) ? (size_t)threads : (size_t)std::thread::hardware_concurrency();
+	numThreads = std::min(numThreads, job.filenames->size());
+	if (numThreads < 1) { numThreads = 1; }
+	job.options.threads = 1; // files are loaded in parallel instead
+	job.options.progress = NULL; // only meaningful for a single file
+	job.options.stats = NULL;
+	job.options.cacheFile.clear(); // names a single file, every file would read (and write) the same cache
+	std::vector<std::thread> workers;
+	for (size_t t = 1; t < numThreads; ++t) {
+		workers.push_back(std::thread(RunBatchJob, &job));
+	}
+	RunBatchJob(&job);
+	for (size_t t = 0; t < workers.size(); ++t) {
+		workers[t].join();
+	}
+}
+
+void OBJBatchLoader::Load(const std::vector<std::string> &filenames, Handler &handler) const
+{
+	BatchJob job;
+	job.filenames = &filenames;
+	job.options = options.load;
+	job.handler = &handler;
+	job.ordered = options.ordered;
+	job.maxPending = std::max(options.maxPending, (size_t)1);
+	if (job.ordered) {
+		job.ready.assign(filenames.size(), NULL);
+	}
+	RunBatch(job, options.threads);
+}
+
+void OBJBatchLoader::Load(const std::vector<std::string> &filenames, std::vector<OBJ> &objs) const
+{
+	objs.clear();
+	objs.resize(filenames.size());
+	BatchJob job;
+	job.filenames = &filenames;
+	job.options = options.load;
+	job.objs = &objs;
+	RunBatch(job, options.threads);
+}
+
+static OBJ LoadAsync(std::string filename, OBJ::Options options, OBJ::Progress *progress)
+{
+	options.progress = progress;
+	return OBJ(filename, options);
+}
+
+OBJAsyncLoad::OBJAsyncLoad(const std::string &filename, const OBJ::Options &options) : progress(), result()
+{
+	result = std::async(std::launch::async, LoadAsync, filename, options, &progress);
+}
+
+OBJAsyncLoad::~OBJAsyncLoad( void )
+{
+	if (result.valid()) { // progress must outlive the load
+		progress.Cancel();
+		result.wait();
+	}
+}
+
+bool OBJAsyncLoad::IsDone( void ) const
+{
+	return !result.valid() || result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+bool OBJAsyncLoad::Wait(int milliseconds) const
+{
+	return !result.valid() || result.wait_for(std::chrono::milliseconds(milliseconds)) == std::future_status::ready;
+}
+
+OBJ OBJAsyncLoad::Get( void )
+{
+	return result.get();
+}
@@ -8,7 +8,13 @@
 #define WAVEFRONTOBJ_H_INCLUDED__
 
 #include <list>
+#include <map>
+#include <vector>
 #include <string>
+#include <memory>
+#include <atomic>
+#include <future>
+#include <unordered_map>
 #include <sstream>
 #include <fstream>
 
@@ -37,9 +43,10 @@ public:
 	typedef Array<float,3> float3;
 	typedef Array<int,3> index3;
 	
-	typedef std::list<float4> VertexList;
-	typedef std::list<float3> TexCoordList;
-	typedef std::list<float3> NormalList;
+	// vertex and facet data is stored contiguously for O(1) access by index
+	typedef std::vector<float4> VertexList;
+	typedef std::vector<float3> TexCoordList;
+	typedef std::vector<float3> NormalList;
 	
 	enum { X, Y, Z, W };
 	enum { U, V, Q };
@@ -53,20 +60,86 @@ public:
 		index3 texCoord;
 		index3 normal;
 		int material;
+		int smoothingGroup; // 0 = not smoothed ("s off")
+	};
+	typedef std::vector<Facet> FacetList;
+	
+	struct Batch // facets that can be drawn without changing material
+	{
+		int material;
+		int firstFacet;
+		int facetCount;
+	};
+	typedef std::vector<Batch> BatchList;
+	
+	// facets are added in order, so a set of facet indices is stored as
+	// contiguous [begin, end) ranges, but iterates like a list of indices
+	class FacetIndexList
+	{
+	public:
+		struct Range
+		{
+			int begin;
+			int end;
+		};
+		typedef std::vector<Range> RangeList;
+		
+		class const_iterator
+		{
+		private:
+			RangeList::const_iterator range;
+			RangeList::const_iterator rangeEnd;
+			int index;
+		public:
+			const_iterator(RangeList::const_iterator r, RangeList::const_iterator e) : range(r), rangeEnd(e), index(r != e ? r->begin : 0) {}
+			int operator*( void ) const { return index; }
+			const_iterator &operator++( void ) { if (++index == range->end && ++range != rangeEnd) { index = range->begin; } return *this; }
+			const_iterator operator++(int) { const_iterator it = *this; ++(*this); return it; }
+			bool operator==(const const_iterator &it) const { return range == it.range && (range == rangeEnd || index == it.index); }
+			bool operator!=(const const_iterator &it) const { return !(*this == it); }
+		};
+		typedef const_iterator iterator;
+		
+	private:
+		RangeList ranges;
+		size_t count;
+	public:
+		FacetIndexList( void ) : ranges(), count(0) {}
+		void push_back(int index)
+		{
+			if (ranges.empty() || ranges.back().end != index) {
+				Range range = { index, index };
+				ranges.push_back(range);
+			}
+			++ranges.back().end;
+			++count;
+		}
+		void push_back(const Range &range)
+		{
+			if (ranges.empty() || ranges.back().end != range.begin) {
+				ranges.push_back(range);
+			} else {
+				ranges.back().end = range.end;
+			}
+			count += (size_t)(range.end - range.begin);
+		}
+		void clear( void ) { ranges.clear(); count = 0; }
+		size_t size( void ) const { return count; }
+		bool empty( void ) const { return count == 0; }
+		const_iterator begin( void ) const { return const_iterator(ranges.begin(), ranges.end()); }
+		const_iterator end( void ) const { return const_iterator(ranges.end(), ranges.end()); }
+		const RangeList &GetRanges( void ) const { return ranges; }
 	};
-	typedef std::list<Facet> FacetList;
-	typedef std::list<int> FacetIndexList;
 	
 	struct Group
 	{
-		// would be awesome to group faces by materials within a Group
-		// reduces state changes in OpenGL, but maybe I should leave that
-		// to the app using the importer.
+		// faces are not grouped by materials within a Group, see
+		// LevelOfDetail::SortByMaterial for reducing state changes.
 		std::string name;
 		FacetIndexList facets;
 		Group( void ) : name("default"), facets() {}
 	};
-	typedef std::list<Group> GroupList;
+	typedef std::vector<Group> GroupList;
 	
 	class Material
 	{
@@ -74,6 +147,21 @@ public:
 		static const int FLAT = 0;
 		static const int DIFFUSE = 1;
 		static const int DIFFUSE_AND_SPECULAR = 2;
+		enum Map // index of each texture map, see GetMap
+		{
+			AMBIENT_MAP,
+			DIFFUSE_MAP,
+			SPECULAR_MAP,
+			EMISSIVE_MAP,
+			TRANSMISSION_MAP,
+			SHININESS_MAP,
+			ALPHA_MAP,
+			DISSOLVE_MAP,
+			DISPLACEMENT_MAP,
+			DETAIL_MAP,
+			BUMP_MAP,
+			MAP_COUNT
+		};
 	public:
 		std::string name;
 		float4 ambient; // Ka
@@ -98,13 +186,122 @@ public:
 		std::string displacementMap;
 		std::string detailMap;
 		std::string bumpMap;
+		// map paths are resolved relative to the .obj file, but the files are not opened
+		// bit (1 << Map) is set if the file of the map exists (or for every map that is named when checks are off, see Options::checkMaps)
+		unsigned int validMaps;
 	public:
 		Material( void );
+		const std::string &GetMap(Map map) const;
+		bool IsMapValid(Map map) const { return (validMaps & (1u << map)) != 0; }
+	};
+	
+	// the materials of a material library
+	// libraries are parsed once per process and shared (read only) between all OBJ:s that use them, see ReadMaterialLibrary
+	struct MaterialTable
+	{
+		std::string fileName;
+		std::vector<Material> materials;
+		std::vector<int> lineNo; // line of each "newmtl"
+		std::list<std::string> errors;
+		std::list<std::string> warnings;
+	};
+	
+	// the materials of an OBJ are references into material tables
+	// (the tables are kept alive for as long as they are referenced)
+	class MaterialList
+	{
+	public:
+		class const_iterator
+		{
+		private:
+			std::vector<const Material*>::const_iterator material;
+		public:
+			explicit const_iterator(std::vector<const Material*>::const_iterator m) : material(m) {}
+			const Material &operator*( void ) const { return **material; }
+			const Material *operator->( void ) const { return *material; }
+			const_iterator &operator++( void ) { ++material; return *this; }
+			const_iterator operator++(int) { const_iterator it = *this; ++material; return it; }
+			bool operator==(const const_iterator &it) const { return material == it.material; }
+			bool operator!=(const const_iterator &it) const { return material != it.material; }
+		};
+		typedef const_iterator iterator;
+		
+	private:
+		std::vector<const Material*> materials;
+		std::vector< std::shared_ptr<const MaterialTable> > tables;
+	public:
+		void push_back(const std::shared_ptr<const MaterialTable> &table, size_t index) // index into table->materials
+		{
+			if (tables.empty() || tables.back() != table) {
+				tables.push_back(table);
+			}
+			materials.push_back(&table->materials[index]);
+		}
+		void clear( void ) { materials.clear(); tables.clear(); }
+		size_t size( void ) const { return materials.size(); }
+		bool empty( void ) const { return materials.empty(); }
+		const Material &operator[](size_t i) const { return *materials[i]; }
+		const Material &front( void ) const { return *materials.front(); }
+		const Material &back( void ) const { return *materials.back(); }
+		const_iterator begin( void ) const { return const_iterator(materials.begin()); }
+		const_iterator end( void ) const { return const_iterator(materials.end()); }
+	};
+	
+	struct Vertex // a unique combination of position, texture coordinate and normal (missing elements are 0)
+	{
+		float4 position;
+		float3 texCoord;
+		float3 normal;
+	};
+	typedef std::vector<Vertex> InterleavedVertexList;
+	
+	// vertices and three indices per facet that can be handed directly to the GPU
+	// indices are 16 bit if there are few enough vertices, otherwise 32 bit (the other list is empty)
+	struct IndexedMesh
+	{
+		InterleavedVertexList vertices;
+		std::vector<unsigned short> indices16;
+		std::vector<unsigned int> indices32;
+		bool Is32Bit( void ) const { return vertices.size() > 0x10000; }
+	};
+	
+	// a cluster of facets that is small enough to be culled and drawn as a unit
+	struct Meshlet
+	{
+		static const int MAX_VERTICES = 64;
+		static const int MAX_FACETS = 124;
+		int firstFacet; // the facets of the meshlet are LevelOfDetail::facets[firstFacet, firstFacet + facetCount)
+		int facetCount;
+		int firstVertex; // into MeshletList::vertices
+		int vertexCount;
+		float3 center; // bounding sphere
+		float radius;
+		float3 coneAxis; // all facet normals are within acos(coneCutoff) of coneAxis
+		float coneCutoff; // -1 if the normals can not be bounded (the cone is only useful for culling if > 0)
+	};
+	struct MeshletList
+	{
+		std::vector<Meshlet> meshlets;
+		std::vector<unsigned int> vertices; // index into IndexedMesh::vertices (see BuildIndexedMesh)
+		std::vector<unsigned char> indices; // three per facet in LevelOfDetail::facets, index into the vertices of its meshlet
+	};
+	
+	struct CacheStatistics // simulated FIFO post-transform vertex cache
+	{
+		float ACMR; // average cache miss ratio, transformed vertices per facet (0.5 - 3, lower is better)
+		float ATVR; // average transformed vertex ratio, transformed vertices per unique vertex (1 is optimal)
+	};
+	
+	enum NormalWeighting // how much each facet contributes to a generated vertex normal
+	{
+		WEIGHT_AREA,
+		WEIGHT_ANGLE // angle of the facet at the vertex (less dependent on how the surface is tessellated)
 	};
-	typedef std::list<Material> MaterialList;
 	
 	class LevelOfDetail
 	{
+	public:
+		static const int VERTEX_CACHE_SIZE = 32;
 	public:
 		// vertex properties
 		VertexList vertices;
@@ -113,43 +310,333 @@ public:
 		// face definition and properties
 		FacetList facets;
 		GroupList groups;
+		BatchList batches; // filled by SortByMaterial
 		// level of detail info
 		int levelOfDetail;
+	private:
+		std::unordered_map<std::string, int> groupLookup; // index of each group by name
+	private:
+		size_t WeldIndices(std::vector<unsigned int> &indices, std::vector<int> *keys) const;
+		void FindRuns(std::vector<int> &runs) const;
+	public:
+		LevelOfDetail( void ) : levelOfDetail(0) {}
+		int AddGroup(const std::string &groupName); // index into groups, the group is created if it does not exist
+		int FindGroup(const std::string &groupName) const; // index into groups, or -1 if there is no such group
+		void BuildIndexedMesh(IndexedMesh &mesh) const; // welds identical v/vt/vn combinations into single vertices
+		CacheStatistics GetCacheStatistics(int cacheSize = VERTEX_CACHE_SIZE) const;
+		void OptimizeVertexCache( void ); // reorders facets for vertex reuse, facets only move within runs of the same groups and material
+		void SortByMaterial( void ); // reorders facets by material (keeping their order otherwise) and creates one batch per material
+		void BuildMeshlets(MeshletList &meshlets, int threads = 0) const; // splits runs of the same groups and material into meshlets in facet order, one thread per run (0 = one per core)
+		// generates normals for facets without normals (or all facets if replace is set)
+		// facets in the same smoothing group share normals at vertices unless the angle between them is larger than creaseAngle (radians, >= pi for no creases)
+		// facets that are not smoothed get one normal per facet, facets with vertex indices out of range are skipped (and lose their normals if replace is set)
+		void GenerateNormals(NormalWeighting weighting = WEIGHT_ANGLE, float creaseAngle = 3.14159265f, bool replace = false);
 	};
 	typedef std::list<LevelOfDetail> LODList;
+	
+	// progress of a load that can be watched and cancelled from another thread, see Options::progress and OBJAsyncLoad
+	// can be used for one load at a time, the byte counts start over when a load starts (but a cancelled Progress stays cancelled)
+	class Progress
+	{
+		friend class OBJ;
+	public:
+		static const int CHECK_INTERVAL = 4096; // lines parsed between updates (and checks for cancellation)
+		enum Phase
+		{
+			WAITING, // the load has not started
+			READING_CACHE, // see Options::cacheFile
+			READING_OBJ,
+			READING_MTL, // a material library that is used by the .obj (its bytes are not counted)
+			POST_PROCESSING, // see Options::generateNormals, writing the binary cache
+			DONE // also when the load was cancelled or failed
+		};
+	private:
+		std::atomic<long long> bytesRead;
+		std::atomic<long long> totalBytes;
+		std::atomic<int> phase;
+		std::atomic<bool> cancelled;
+	private:
+		Progress(const Progress&) {}
+		Progress &operator=(const Progress&) { return *this; }
+		bool Advance(long long bytes) { bytesRead += bytes; return !IsCancelled(); } // false if the load should stop
+		void Restart( void ) { bytesRead = 0; totalBytes = 0; } // cancelled is kept, so that a load can be cancelled before it starts
+	public:
+		Progress( void ) : bytesRead(0), totalBytes(0), phase(WAITING), cancelled(false) {}
+		long long GetBytesRead( void ) const { return bytesRead; } // bytes of the .obj that have been parsed
+		long long GetTotalBytes( void ) const { return totalBytes; } // size of the .obj (0 until it has been opened)
+		Phase GetPhase( void ) const { return (Phase)phase.load(); }
+		void Cancel( void ) { cancelled = true; } // the load stops at its next check, the OBJ is left empty except for the error "Loading was cancelled" (later loads with the same Progress stop right away)
+		bool IsCancelled( void ) const { return cancelled; }
+	};
+	
+	// where the time and memory of a load went, see Options::stats
+	// lines are too short to time one by one, so every SAMPLE_INTERVAL:th line is timed and the time is scaled up
+	// (samples that were interrupted by the scheduler or by an array growing are dropped)
+	struct LoadStats
+	{
+		static const int SAMPLE_INTERVAL = 64;
+		enum Phase
+		{
+			READ_LINES, // finding and splitting lines (sampled)
+			PARSE_VERTICES, // v, vt and vn (sampled)
+			PARSE_FACES, // f, including triangulation (sampled)
+			PARSE_OTHER, // all other lines (sampled)
+			GROW_ARRAYS, // moving element arrays to larger memory as they grow (sampled lines that grow an array are not counted above)
+			STITCH_CHUNKS, // joining the chunks of a parallel load in file order (the chunks themselves are counted above, summed over all threads)
+			READ_MTL, // material libraries that were not already cached (excluding CHECK_MAPS)
+			CHECK_MAPS,
+			READ_CACHE, // see Options::cacheFile
+			POST_PROCESS, // see Options::generateNormals, writing the binary cache
+			PHASE_COUNT
+		};
+		double seconds[PHASE_COUNT];
+		double totalSeconds; // wall time of the constructor
+		std::map<std::string, size_t> lines; // number of lines per keyword ("#" for comments and empty lines)
+		long long bytesRead; // of the .obj, the material libraries that were parsed and the binary cache
+		size_t allocations; // times that the element arrays (vertices, texCoords, normals, facets) had to grow, temporaries are not counted
+		size_t peakBytes; // largest number of bytes held by the element arrays of all LOD:s (and the chunks of a parallel load) at once
+		LoadStats( void ) : seconds(), totalSeconds(0.0), lines(), bytesRead(0), allocations(0), peakBytes(0) {}
+	};
+	
+	struct Options
+	{
+		int threads; // number of threads used to parse large files (0 = one per core, 1 = single threaded)
+		std::string cacheFile; // binary cache that is loaded instead of the .obj if it is newer than the .obj and its material libraries, otherwise it is written after parsing (empty = no cache)
+		bool generateNormals; // calls GenerateNormals with default arguments on every LOD after loading (unless there are errors)
+		bool checkMaps; // checks that texture maps exist when a material library is parsed (with stat or one directory listing per directory, files are never opened), otherwise all maps are assumed to be valid
+		Progress *progress; // updated while loading and checked for cancellation (NULL = not reported), must outlive the load
+		LoadStats *stats; // filled in by the constructor (NULL = not collected)
+		Options( void ) : threads(0), cacheFile(), generateNormals(false), checkMaps(true), progress(NULL), stats(NULL) {}
+	};
+	
+	// receives the contents of a file while it is parsed instead of storing them in levelOfDetail
+	// facets are triangles with indices relative to the current LOD (polygons are split into fans)
+	// facets belong to the group "default", the default material (index 0) and no smoothing group until told otherwise
+	class Handler
+	{
+	public:
+		virtual ~Handler( void ) {}
+		virtual void OnVertex(const float4 &) {}
+		virtual void OnTexCoord(const float3 &) {}
+		virtual void OnNormal(const float3 &) {}
+		virtual void OnFace(const Facet &) {}
+		virtual void OnGroup(const std::vector<std::string> &) {} // the groups that following facets belong to
+		virtual void OnUseMtl(int) {} // the material index that following facets use
+		virtual void OnLod(int) {} // following elements belong to a new LOD, indices start over (groups and material carry over)
+		virtual void OnMaterial(const Material &, int) {} // a material and its index, called before any facet can use it
+	};
+	
+	// binary cache layout (see SaveBinary)
+	// all arrays start at an offset from the start of the file that is
+	// a multiple of ALIGNMENT so that the file can be read (or mapped)
+	// directly into memory
+	struct Binary
+	{
+		static const unsigned int MAGIC = 0x4a424f57; // "WOBJ" (also fails on mismatching byte order)
+		static const unsigned int VERSION = 4;
+		static const size_t ALIGNMENT = 16;
+	};
 private:
+	struct Span // non-owning view of a range of characters (used to avoid copying lines)
+	{
+		const char *begin;
+		const char *end;
+		Span( void ) : begin(NULL), end(NULL) {}
+		Span(const char *b, const char *e) : begin(b), end(e) {}
+		size_t size( void ) const { return (size_t)(end - begin); }
+		bool empty( void ) const { return begin == end; }
+		char operator[](size_t i) const { return begin[i]; }
+		bool operator==(const char *str) const;
+		bool operator==(const std::string &str) const;
+		bool operator!=(const char *str) const { return !(*this == str); }
+		std::string str( void ) const { return std::string(begin, end); }
+		friend std::ostream &operator<<(std::ostream &out, const Span &span) { return out.write(span.begin, (std::streamsize)span.size()); }
+	};
+
+	enum ObjKeyword
+	{
+		OBJ_NONE, // empty line or comment
+		OBJ_UNKNOWN,
+		OBJ_v, // supported
+		OBJ_vt, // supported
+		OBJ_vn, // supported
+		OBJ_f, // supported
+		OBJ_o, // supported
+		OBJ_vp,
+		OBJ_deg, // implement?
+		OBJ_bmat, // implement?
+		OBJ_step,
+		OBJ_cstype,
+		OBJ_p,
+		OBJ_l,
+		OBJ_curv,
+		OBJ_curv2,
+		OBJ_surf,
+		OBJ_parm,
+		OBJ_trim,
+		OBJ_hole,
+		OBJ_scrv,
+		OBJ_sp,
+		OBJ_end,
+		OBJ_con,
+		OBJ_g, // supported
+		OBJ_s, // supported
+		OBJ_mg,
+		OBJ_bevel,
+		OBJ_c_interp,
+		OBJ_d_interp,
+		OBJ_lod, // supported
+		OBJ_usemtl, // supported
+		OBJ_mtllib, // supported
+		OBJ_shadow_obj, // supported
+		OBJ_trace_obj,
+		OBJ_ctech,
+		OBJ_stech,
+		OBJ_maplib,
+		OBJ_usemap,
+		OBJ_KEYWORD_COUNT
+	};
+
+	enum MtlKeyword
+	{
+		MTL_NONE, // empty line or comment
+		MTL_UNKNOWN,
+		MTL_newmtl, // supported
+		MTL_Ka, // supported
+		MTL_Kd, // supported
+		MTL_Ks, // supported
+		MTL_Ke, // supported
+		MTL_Tr, // supported
+		MTL_d, // supported
+		MTL_Tf, // supported
+		MTL_Ns, // supported
+		MTL_Ni, // supported
+		MTL_sharpness, // supported
+		MTL_illum, // supported
+		MTL_map_Ka, // supported
+		MTL_map_Kd, // supported
+		MTL_map_Ks, // supported
+		MTL_map_Ke, // supported
+		MTL_map_Tf, // supported
+		MTL_map_Ns, // supported
+		MTL_map_Tr, // supported
+		MTL_map_d, // supported
+		MTL_disp, // supported
+		MTL_decal, // supported
+		MTL_bump // supported
+	};
+
 	struct File
 	{
+		// input is memory mapped when possible, otherwise it is read through fin
+		const char *mapBegin;
+		const char *mapEnd;
+		const char *cursor;
 		std::ifstream fin;
+		std::string line; // line buffer for fin
+		long long lineEnd; // bytes read through fin
 		std::string name;
 		int lineNo;
-		std::string type;
-		std::string params;
+		Span type;
+		Span params;
+		File( void ) : mapBegin(NULL), mapEnd(NULL), cursor(NULL), lineEnd(0), lineNo(0) {}
+		~File( void );
+		bool IsMapped( void ) const { return cursor != NULL; }
+		long long GetOffset( void ) const { return IsMapped() ? (long long)(cursor - mapBegin) : lineEnd; }
+		bool Eof( void ) const { return IsMapped() ? cursor == mapEnd : fin.eof(); }
+	};
+
+	struct Chunk // a part of a mapped file that is parsed by a separate thread
+	{
+		static const size_t MIN_SIZE = 1 << 20; // smaller files are not worth splitting up
+		struct Line // a line that has to be handled in file order (including all faces)
+		{
+			int lineNo; // relative to the first line of the chunk
+			int numVertices; // number of elements parsed in the chunk before this line
+			int numTexCoords;
+			int numNormals;
+			int faceBegin; // decoded face indices, faceBegin == faceEnd if the line is not a face
+			int faceEnd;
+			Span type;
+			Span params;
+		};
+		const char *begin;
+		const char *end;
+		int numLines;
+		VertexList vertices;
+		TexCoordList texCoords;
+		NormalList normals;
+		std::vector<int> faceIndices;
+		std::vector<Line> lines;
+		Progress *progress;
+		bool sampled; // lines are timed, see LoadStats
+		double seconds[LoadStats::PHASE_COUNT];
+		size_t lineCount[OBJ_KEYWORD_COUNT]; // lines that are not handled by ReadObjLine
+		size_t allocations;
+		Chunk( void ) : begin(NULL), end(NULL), numLines(0), progress(NULL), sampled(false), seconds(), lineCount(), allocations(0) {}
+		size_t GetBytes( void ) const { return vertices.capacity() * sizeof(float4) + texCoords.capacity() * sizeof(float3) + normals.capacity() * sizeof(float3) + faceIndices.capacity() * sizeof(int) + lines.capacity() * sizeof(Line); }
 	};
 
 	struct StateVariables
 	{
 		LODList::iterator LOD;
-		std::list<GroupList::iterator> groups;
-		MaterialList::iterator material;
+		std::vector<int> groups; // indices into LOD->groups
 		int materialIndex;
-		StateVariables( void ) : materialIndex(0) {}
+		int smoothingGroup;
+		bool checkMaps; // see Options::checkMaps
+		std::string workingDirectory; // 'mtllib' et al. are relative to the .obj file
+		std::vector<int> face; // intermediate for storing the current face (reused between lines to avoid allocations)
+		std::ostringstream sout; // for concatenating error/warning strings
+		std::string name; // intermediate for looking up names (reused between lines to avoid allocations)
+		Handler *handler; // receives the elements instead of LOD when not NULL
+		int numVertices; // number of elements in the current LOD that were passed to handler
+		int numTexCoords;
+		int numNormals;
+		int numFacets;
+		std::vector<std::string> groupNames; // intermediate for passing groups to handler
+		Progress *progress; // see Options::progress
+		LoadStats *stats; // see Options::stats
+		size_t lineCount[OBJ_KEYWORD_COUNT];
+		size_t allocations; // see LoadStats::allocations
+		double growSeconds; // see LoadStats::GROW_ARRAYS
+		StateVariables( void ) : materialIndex(0), smoothingGroup(0), checkMaps(true), handler(NULL), numVertices(0), numTexCoords(0), numNormals(0), numFacets(0), progress(NULL), stats(NULL), lineCount(), allocations(0), growSeconds(0.0) {}
 	};
-private:
-	OBJ( void );
 private:
 	bool Open(File &file, const std::string &filename);
 	void ReadLine(File &file) const;
+	static void SplitLine(const char *begin, const char *end, Span &type, Span &params);
+	static ObjKeyword GetObjKeyword(const Span &type);
+	static LoadStats::Phase GetParsePhase(ObjKeyword keyword);
+	static void AddLineCounts(const size_t *lineCount, LoadStats &stats);
+	static MtlKeyword GetMtlKeyword(const Span &type);
 	void AddError(const File &file, std::ostringstream &sout);
 	void AddWarning(const File &file, std::ostringstream &sout);
 	template < typename type_t >
 	void Swap(type_t &val1, type_t &val2) const;
+	static bool ReadValue(const char *&in, const char *end, float &out);
+	static bool ReadValue(const char *&in, const char *end, int &out);
+	static bool ReadValue(const char *&in, const char *end, std::string &out);
 	template < typename type_t >
 	void ReadParams(const File &file, int minParams, int maxParams, const type_t &defaultValue, type_t *out);
 	template < typename type_t >
 	void ReadParams(const File &file, int params, type_t *out);
+	template < typename type_t >
+	static bool TryReadParams(const Span &params, int minParams, int maxParams, const type_t &defaultValue, type_t *out);
 	template < typename T >
 	void ReadVariableParams(const File &file, int minParams, std::list<T> &out);
+	void ResolveFaceVertex(const File &file, const int *size, int *index);
+	bool ReadFace(const File &file, int numVertices, int numTexCoords, int numNormals, std::vector<int> &face);
+	void AddFace(const File &objFile, StateVariables &state);
+	void ReadObjLine(File &objFile, StateVariables &state);
+	void ReadMaterialLibrary(const File &objFile, StateVariables &state);
+	void ParseMaterialLibrary(File &mtlFile, const std::string &workingDirectory, MaterialTable &table);
+	static std::shared_ptr<const MaterialTable> LoadMaterialLibrary(const std::string &filename, const std::string &workingDirectory, bool checkMaps, LoadStats *stats);
+	static void ParseChunk(Chunk *chunk);
+	void ReadObjParallel(File &objFile, StateVariables &state, int numChunks);
+	void Read(const std::string &filename, const Options &options, Handler *handler);
+	bool ReadBinary(const std::string &filename, const std::string &sourceFile);
+	bool CheckCancelled(const std::string &filename, const Progress *progress);
+	void Clear( void );
 public:
 	std::string fileName;
 	std::string name;
@@ -157,10 +644,14 @@ public:
 	LODList levelOfDetail;
 	MaterialList materials;
 private:
+	std::unordered_map<std::string, int> materialLookup; // index of each material by name
+	std::vector<std::string> libraries; // material libraries that were read (the binary cache is only valid while they are unchanged)
 	std::list<std::string> errors;
 	std::list<std::string> warnings;
 public:
-	explicit OBJ(const std::string &filename);
+	OBJ( void );
+	explicit OBJ(const std::string &filename, const Options &options = Options());
+	OBJ(const std::string &filename, Handler &handler, const Options &options = Options()); // streams the file to handler, only materials, errors and warnings are kept
 public:
 	enum Status
 	{
@@ -170,7 +661,15 @@ public:
 	};
 public:
 	Status GetStatus( void ) const;
+	int FindMaterial(const std::string &materialName) const; // index into materials, or -1 if there is no such material
+	static void ClearMaterialCache( void ); // releases material libraries that are not used by any OBJ (they are otherwise kept until exit)
 	void Reverse( void );
+	void Transform(const float *matrix); // 4x4 row major matrix applied to positions (as column vectors), normals are transformed by the inverse transpose (not normalized), winding is swapped if the matrix mirrors
+	void Scale(float scale); // uniform scale of positions
+	void FlipAxis(int axis); // mirrors positions and normals along X, Y or Z (other values are ignored), winding is swapped to keep facets facing outwards
+	void SwapHandedness( void ) { FlipAxis(Z); } // converts between right and left handed coordinates
+	bool SaveBinary(const std::string &filename) const; // false if the file could not be written
+	bool LoadBinary(const std::string &filename); // replaces the current contents, false if the file is not a valid binary cache
 	bool HasErrors( void ) const { return !errors.empty(); }
 	bool HasWarnings( void ) const { return !warnings.empty(); }
 	void DumpErrors(std::ostream &out, const unsigned int MaxErrors) const;
@@ -188,16 +687,16 @@ void OBJ::Swap(type_t &val1, type_t &val2) const
 template < typename type_t >
 void OBJ::ReadParams(const OBJ::File &file, int minParams, int maxParams, const type_t &defaultValue, type_t *out)
 {
-	std::istringstream sin(file.params);
+	const char *in = file.params.begin;
 	int numParams = 0;
 	
-	while (numParams < maxParams && sin >> out[numParams]) {
+	while (numParams < maxParams && ReadValue(in, file.params.end, out[numParams])) {
 		++numParams;
 	}
 		
 	// if too many arguments, count them
 	type_t value;
-	while (sin >> value) {
+	while (ReadValue(in, file.params.end, value)) {
 		++numParams;
 	}
 	
@@ -223,13 +722,32 @@ void OBJ::ReadParams(const OBJ::File &file, int params, type_t *out)
 	ReadParams(file, params, params, temp, out);
 }
 
+// same as ReadParams, but does not report errors (safe to call from any thread)
+template < typename type_t >
+bool OBJ::TryReadParams(const Span &params, int minParams, int maxParams, const type_t &defaultValue, type_t *out)
+{
+	const char *in = params.begin;
+	int numParams = 0;
+	while (numParams < maxParams && ReadValue(in, params.end, out[numParams])) {
+		++numParams;
+	}
+	type_t value;
+	if (numParams < minParams || ReadValue(in, params.end, value)) {
+		return false;
+	}
+	for (int i = numParams; i < maxParams; ++i) {
+		out[i] = defaultValue;
+	}
+	return true;
+}
+
 template < typename T >
 void OBJ::ReadVariableParams(const OBJ::File &file, int minParams, std::list<T> &out)
 {
-	std::istringstream sin(file.params);
+	const char *in = file.params.begin;
 	int numParams = 0;
 	T value;
-	while (sin >> value) {
+	while (ReadValue(in, file.params.end, value)) {
 		out.push_back(value);
 		++numParams;
 	}
@@ -243,4 +761,205 @@ void OBJ::ReadVariableParams(const OBJ::File &file, int minParams, std::list<T>
 	}
 }
 
+// read-only view of a binary cache written by OBJ::SaveBinary
+// the file is memory mapped and all arrays point directly into the mapping,
+// so nothing is copied and processes that view the same file share memory
+// everything returned by the view is only valid while the view exists
+class OBJView
+{
+public:
+	template < typename type_t >
+	class Array
+	{
+	private:
+		const type_t *data;
+		unsigned int count;
+	public:
+		Array( void ) : data(NULL), count(0) {}
+		Array(const type_t *d, unsigned int c) : data(d), count(c) {}
+		size_t size( void ) const { return count; }
+		bool empty( void ) const { return count == 0; }
+		const type_t &operator[](size_t i) const { return data[i]; }
+		const type_t *begin( void ) const { return data; }
+		const type_t *end( void ) const { return data + count; }
+	};
+	
+	struct String // not null terminated
+	{
+		const char *begin;
+		const char *end;
+		String( void ) : begin(NULL), end(NULL) {}
+		size_t size( void ) const { return (size_t)(end - begin); }
+		bool empty( void ) const { return begin == end; }
+		std::string str( void ) const { return std::string(begin, end); }
+		friend std::ostream &operator<<(std::ostream &out, const String &string) { return out.write(string.begin, (std::streamsize)string.size()); }
+	};
+	
+	// records vary in size, so they are decoded one at a time while iterating
+	template < typename record_t >
+	class RecordList
+	{
+	public:
+		class const_iterator
+		{
+		private:
+			const char *base;
+			const char *next;
+			const char *mapEnd;
+			unsigned int remaining;
+			record_t record;
+		public:
+			const_iterator(const char *b, const char *at, const char *e, unsigned int r) : base(b), next(at), mapEnd(e), remaining(r), record() { if (remaining > 0) { next = OBJView::Decode(base, next, mapEnd, record); } }
+			const record_t &operator*( void ) const { return record; }
+			const record_t *operator->( void ) const { return &record; }
+			const_iterator &operator++( void ) { if (--remaining > 0) { next = OBJView::Decode(base, next, mapEnd, record); } return *this; }
+			bool operator==(const const_iterator &it) const { return remaining == it.remaining; }
+			bool operator!=(const const_iterator &it) const { return remaining != it.remaining; }
+		};
+		typedef const_iterator iterator;
+	private:
+		const char *base;
+		const char *first;
+		const char *mapEnd;
+		unsigned int count;
+	public:
+		RecordList( void ) : base(NULL), first(NULL), mapEnd(NULL), count(0) {}
+		RecordList(const char *b, const char *f, const char *e, unsigned int c) : base(b), first(f), mapEnd(e), count(c) {}
+		size_t size( void ) const { return count; }
+		bool empty( void ) const { return count == 0; }
+		const_iterator begin( void ) const { return const_iterator(base, first, mapEnd, count); }
+		const_iterator end( void ) const { return const_iterator(base, first, mapEnd, 0); }
+	};
+	
+	struct Group
+	{
+		String name;
+		Array<OBJ::FacetIndexList::Range> facets;
+	};
+	typedef RecordList<Group> GroupList;
+	
+	struct Material // same as OBJ::Material
+	{
+		String name;
+		OBJ::float4 ambient;
+		OBJ::float4 diffuse;
+		OBJ::float4 specular;
+		OBJ::float4 emissive;
+		OBJ::float4 transmission;
+		float alpha;
+		float dissolve;
+		float shininess;
+		float opticalDensity;
+		float sharpness;
+		int illumination;
+		String ambientMap;
+		String diffuseMap;
+		String specularMap;
+		String emissiveMap;
+		String transmissionMap;
+		String shininessMap;
+		String alphaMap;
+		String dissolveMap;
+		String displacementMap;
+		String detailMap;
+		String bumpMap;
+		unsigned int validMaps;
+	};
+	typedef RecordList<Material> MaterialList;
+	
+	struct LevelOfDetail
+	{
+		int levelOfDetail;
+		Array<OBJ::float4> vertices;
+		Array<OBJ::float3> texCoords;
+		Array<OBJ::float3> normals;
+		Array<OBJ::Facet> facets;
+		GroupList groups;
+		Array<OBJ::Batch> batches;
+	};
+	typedef RecordList<LevelOfDetail> LODList;
+private:
+	const char *mapBegin;
+	const char *mapEnd;
+	bool isMapped; // otherwise the file was read into memory
+	String fileName;
+	String name;
+	String shadowModel;
+	MaterialList materials;
+	LODList levelOfDetail;
+private:
+	OBJView(const OBJView&) {}
+	OBJView &operator=(const OBJView&) { return *this; }
+private:
+	// decode the record at 'at', returns the end of the record or NULL if it exceeds 'end'
+	static const char *Decode(const char *base, const char *at, const char *end, Group &out);
+	static const char *Decode(const char *base, const char *at, const char *end, Material &out);
+	static const char *Decode(const char *base, const char *at, const char *end, LevelOfDetail &out);
+	bool Validate( void );
+	void Close( void );
+public:
+	explicit OBJView(const std::string &filename);
+	~OBJView( void ) { Close(); }
+public:
+	bool IsOpen( void ) const { return mapBegin != NULL; } // false if the file could not be opened or is not a valid binary cache
+	const String &GetFileName( void ) const { return fileName; }
+	const String &GetName( void ) const { return name; }
+	const String &GetShadowModel( void ) const { return shadowModel; }
+	const MaterialList &GetMaterials( void ) const { return materials; }
+	const LODList &GetLevelsOfDetail( void ) const { return levelOfDetail; }
+};
+
+// loads many files concurrently
+// workers take the next file in the list as soon as they are done with the previous one, every file is read by a single thread
+// material libraries are parsed once for all files (see OBJ::ClearMaterialCache)
+class OBJBatchLoader
+{
+public:
+	// receives the files as they are loaded
+	// calls are made from the worker threads, but never at the same time
+	class Handler
+	{
+	public:
+		virtual ~Handler( void ) {}
+		virtual void OnLoad(size_t index, OBJ &obj) = 0; // index into the list of files, obj is destroyed when the call returns
+	};
+	
+	struct Options
+	{
+		int threads; // 0 = one per core
+		bool ordered; // OnLoad is called in the order of the files (otherwise as soon as a file has been loaded)
+		size_t maxPending; // maximum number of files that are loaded ahead while waiting for an earlier file (bounds memory when ordered)
+		OBJ::Options load; // used for every file (load.threads, load.cacheFile, load.progress and load.stats are ignored)
+		Options( void ) : threads(0), ordered(true), maxPending(64), load() {}
+	};
+private:
+	Options options;
+public:
+	explicit OBJBatchLoader(const Options &batchOptions = Options()) : options(batchOptions) {}
+public:
+	void Load(const std::vector<std::string> &filenames, Handler &handler) const;
+	void Load(const std::vector<std::string> &filenames, std::vector<OBJ> &objs) const; // objs[i] is filenames[i] (all files are kept in memory)
+};
+
+// loads a file on a separate thread so that the calling thread can show progress and cancel the load
+// the load is cancelled (and waited for) if the handle is destroyed before Get has been called
+class OBJAsyncLoad
+{
+private:
+	OBJ::Progress progress;
+	std::future<OBJ> result;
+private:
+	OBJAsyncLoad(const OBJAsyncLoad&) {}
+	OBJAsyncLoad &operator=(const OBJAsyncLoad&) { return *this; }
+public:
+	explicit OBJAsyncLoad(const std::string &filename, const OBJ::Options &options = OBJ::Options()); // options.progress is ignored
+	~OBJAsyncLoad( void );
+public:
+	const OBJ::Progress &GetProgress( void ) const { return progress; }
+	void Cancel( void ) { progress.Cancel(); }
+	bool IsDone( void ) const; // Get does not block
+	bool Wait(int milliseconds) const; // false on time out
+	OBJ Get( void ); // waits for the load to finish, may only be called once
+};
+
 #endif
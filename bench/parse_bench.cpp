@@ -0,0 +1,114 @@
+// Measures how many lines per second are parsed from a file that is mostly
+// v, vt and vn lines, with the numeric scanner used by OBJ and with
+// std::getline + std::istringstream (how parameters were parsed before).
+//
+// g++ -std=c++11 -O2 -pthread -I.. parse_bench.cpp ../WavefrontOBJ.cpp -o parse_bench
+// ./parse_bench [file.obj]
+//
+// Without a file, parse_bench.obj is written to the working directory
+// (2M v + 1M vt + 1M vn + 0.5M f lines, about 165 MB).
+
+#include "WavefrontOBJ.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double GetSeconds(const Clock::time_point &start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static float Random( void )
+{
+	return (float)rand() / (float)RAND_MAX * 200.0f - 100.0f;
+}
+
+static bool WriteTestFile(const std::string &filename)
+{
+	static const int NUM_VERTICES = 2000000;
+	FILE *out = fopen(filename.c_str(), "w");
+	if (out == NULL) {
+		return false;
+	}
+	srand(1);
+	for (int i = 0; i < NUM_VERTICES; ++i) {
+		fprintf(out, "v %f %f %f\n", Random(), Random(), Random());
+	}
+	for (int i = 0; i < NUM_VERTICES / 2; ++i) {
+		fprintf(out, "vt %f %f\n", Random() / 100.0f, Random() / 100.0f);
+	}
+	for (int i = 0; i < NUM_VERTICES / 2; ++i) {
+		fprintf(out, "vn %e %e %e\n", Random() / 100.0f, Random() / 100.0f, Random() / 100.0f);
+	}
+	for (int i = 1; i + 2 <= NUM_VERTICES / 2; i += 2) {
+		fprintf(out, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", i, i, i, i + 1, i + 1, i + 1, i + 2, i + 2, i + 2);
+	}
+	return fclose(out) == 0;
+}
+
+// reads all numeric parameters the way ReadParams used to, returns the number of lines
+static size_t ParseWithStreams(const std::string &filename, size_t &numValues)
+{
+	std::ifstream in(filename.c_str());
+	std::string line, type;
+	std::vector<float> values;
+	size_t numLines = 0;
+	while (std::getline(in, line)) {
+		++numLines;
+		std::istringstream sin(line);
+		sin >> type;
+		if (type == "v" || type == "vt" || type == "vn") {
+			float value;
+			while (sin >> value) {
+				values.push_back(value);
+			}
+		}
+	}
+	numValues = values.size();
+	return numLines;
+}
+
+static void Report(const char *name, size_t numLines, double seconds)
+{
+	printf("%-36s %8.3f s %10.2fM lines/s\n", name, seconds, (double)numLines / seconds / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+	std::string filename = (argc > 1) ? argv[1] : "parse_bench.obj";
+	if (argc <= 1 && !WriteTestFile(filename)) {
+		std::cerr << "Could not write " << filename << std::endl;
+		return 1;
+	}
+
+	Clock::time_point start = Clock::now();
+	size_t numValues = 0;
+	const size_t numLines = ParseWithStreams(filename, numValues);
+	Report("getline + istringstream", numLines, GetSeconds(start));
+
+	OBJ::Options options;
+	options.threads = 1;
+	start = Clock::now();
+	OBJ single(filename, options);
+	Report("OBJ, 1 thread", numLines, GetSeconds(start));
+
+	options.threads = 0;
+	start = Clock::now();
+	OBJ parallel(filename, options);
+	Report("OBJ, one thread per core", numLines, GetSeconds(start));
+
+	size_t numElements = 0;
+	for (OBJ::LODList::const_iterator lod = single.levelOfDetail.begin(); lod != single.levelOfDetail.end(); ++lod) {
+		numElements += lod->vertices.size() + lod->texCoords.size() + lod->normals.size();
+	}
+	static const char *STATUS_NAMES[] = { "ok", "warnings", "errors" };
+	printf("%lu lines, %lu values (istringstream), %lu v/vt/vn (OBJ), status %s\n", (unsigned long)numLines, (unsigned long)numValues, (unsigned long)numElements, STATUS_NAMES[single.GetStatus()]);
+	return 0;
+}
@@ -0,0 +1,145 @@
+// Measures LevelOfDetail::BuildIndexedMesh against welding the same v/vt/vn
+// triples with std::map and std::unordered_map, and checks that all three
+// produce the same indices.
+//
+// g++ -std=c++11 -O2 -pthread -I.. weld_bench.cpp ../WavefrontOBJ.cpp -o weld_bench
+// ./weld_bench [file.obj]
+//
+// Without a file, two meshes are generated: a 1600 x 1600 grid (5.1M facets,
+// vertices are shared by up to six facets) and 2M facets with random indices
+// (most corners are new vertices).
+
+#include "WavefrontOBJ.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double GetSeconds(const Clock::time_point &start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Key
+{
+	int v, vt, vn;
+	bool operator<(const Key &key) const { return v != key.v ? v < key.v : (vt != key.vt ? vt < key.vt : vn < key.vn); }
+	bool operator==(const Key &key) const { return v == key.v && vt == key.vt && vn == key.vn; }
+};
+
+struct KeyHash
+{
+	size_t operator()(const Key &key) const { return (size_t)key.v * 73856093u ^ (size_t)key.vt * 19349663u ^ (size_t)key.vn * 83492791u; }
+};
+
+// assigns indices to unique triples in the order they are first seen, like BuildIndexedMesh
+template < typename map_t >
+static void Weld(const OBJ::FacetList &facets, map_t &map, std::vector<unsigned int> &indices)
+{
+	indices.reserve(facets.size() * 3);
+	for (OBJ::FacetList::const_iterator facet = facets.begin(); facet != facets.end(); ++facet) {
+		for (int i = 0; i < 3; ++i) {
+			const Key key = { facet->vertex[i], facet->texCoord[i], facet->normal[i] };
+			indices.push_back(map.insert(std::make_pair(key, (unsigned int)map.size())).first->second);
+		}
+	}
+}
+
+static void AddElements(OBJ::LevelOfDetail &lod, int count)
+{
+	OBJ::float4 vertex = OBJ::float4();
+	vertex[3] = 1.0f;
+	lod.vertices.resize((size_t)count, vertex);
+	lod.texCoords.resize((size_t)count, OBJ::float3());
+	lod.normals.resize((size_t)count, OBJ::float3());
+}
+
+static void AddFacet(OBJ::LevelOfDetail &lod, int a, int b, int c, int offset)
+{
+	OBJ::Facet facet = {};
+	const int corners[3] = { a, b, c };
+	for (int i = 0; i < 3; ++i) {
+		facet.vertex[i] = corners[i];
+		facet.texCoord[i] = (corners[i] + offset) % (int)lod.texCoords.size();
+		facet.normal[i] = corners[i];
+	}
+	lod.facets.push_back(facet);
+}
+
+static void CreateGrid(OBJ::LevelOfDetail &lod, int size)
+{
+	AddElements(lod, (size + 1) * (size + 1));
+	for (int y = 0; y < size; ++y) {
+		for (int x = 0; x < size; ++x) {
+			const int i = y * (size + 1) + x;
+			AddFacet(lod, i, i + 1, i + size + 2, 0);
+			AddFacet(lod, i, i + size + 2, i + size + 1, 0);
+		}
+	}
+}
+
+static int RandomIndex(int count)
+{
+	return (int)(((unsigned int)rand() * 32768u + (unsigned int)rand()) % (unsigned int)count); // RAND_MAX may be 32767
+}
+
+static void CreateRandom(OBJ::LevelOfDetail &lod, int numFacets)
+{
+	AddElements(lod, numFacets * 3);
+	srand(1);
+	for (int i = 0; i < numFacets; ++i) {
+		const int n = (int)lod.vertices.size();
+		AddFacet(lod, RandomIndex(n), RandomIndex(n), RandomIndex(n), RandomIndex(4));
+	}
+}
+
+static void Run(const char *name, const OBJ::LevelOfDetail &lod)
+{
+	Clock::time_point start = Clock::now();
+	OBJ::IndexedMesh mesh;
+	lod.BuildIndexedMesh(mesh);
+	const double hashSeconds = GetSeconds(start);
+
+	start = Clock::now();
+	std::map<Key, unsigned int> map;
+	std::vector<unsigned int> mapIndices;
+	Weld(lod.facets, map, mapIndices);
+	const double mapSeconds = GetSeconds(start);
+
+	start = Clock::now();
+	std::unordered_map<Key, unsigned int, KeyHash> unorderedMap;
+	std::vector<unsigned int> unorderedIndices;
+	Weld(lod.facets, unorderedMap, unorderedIndices);
+	const double unorderedSeconds = GetSeconds(start);
+
+	bool same = (mesh.vertices.size() == map.size() && mapIndices == unorderedIndices);
+	for (size_t i = 0; same && i < mapIndices.size(); ++i) {
+		same = (mesh.Is32Bit() ? mesh.indices32[i] : mesh.indices16[i]) == mapIndices[i];
+	}
+	printf("%s: %lu facets, %lu vertices, %s bit indices%s\n", name, (unsigned long)lod.facets.size(), (unsigned long)mesh.vertices.size(), mesh.Is32Bit() ? "32" : "16", same ? "" : ", INDICES DIFFER");
+	printf("  BuildIndexedMesh   %8.3f s %8.2fM facets/s\n", hashSeconds, (double)lod.facets.size() / hashSeconds / 1e6);
+	printf("  std::map           %8.3f s %8.2fM facets/s\n", mapSeconds, (double)lod.facets.size() / mapSeconds / 1e6);
+	printf("  std::unordered_map %8.3f s %8.2fM facets/s\n", unorderedSeconds, (double)lod.facets.size() / unorderedSeconds / 1e6);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1) {
+		OBJ obj(argv[1]);
+		for (OBJ::LODList::const_iterator lod = obj.levelOfDetail.begin(); lod != obj.levelOfDetail.end(); ++lod) {
+			Run(argv[1], *lod);
+		}
+		return 0;
+	}
+	OBJ::LevelOfDetail grid;
+	CreateGrid(grid, 1600);
+	Run("grid", grid);
+	OBJ::LevelOfDetail random;
+	CreateRandom(random, 2000000);
+	Run("random", random);
+	return 0;
+}
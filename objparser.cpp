@@ -5,12 +5,95 @@
 //
 
 #include <vector>
+#include <chrono>
+#include <algorithm>
 #include <cstdlib>
 #include <cmath>
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "objparser.h"
 
 #include <iostream>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define OBJ_USE_SSE
+	#include <emmintrin.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static double GetSeconds(const Clock::time_point &begin, const Clock::time_point &end)
+{
+	return std::chrono::duration<double>(end - begin).count();
+}
+
+static double MeasureClockOverhead( void )
+{
+	double overhead = 1.0;
+	for (int i = 0; i < 16; ++i) {
+		const Clock::time_point begin = Clock::now();
+		overhead = std::min(overhead, GetSeconds(begin, Clock::now()));
+	}
+	return overhead;
+}
+
+// adds the time of a sampled line to a phase, see OBJ::LoadStats
+// the cost of reading the clock is subtracted (it would otherwise be scaled up with the sample)
+// samples that take longer than any line should are dropped, the thread was most likely preempted
+static void AddSample(double *seconds, int phase, const Clock::time_point &begin, const Clock::time_point &end)
+{
+	static const double MAX_SAMPLE_SECONDS = 1e-4;
+	static const double CLOCK_OVERHEAD = MeasureClockOverhead();
+	const double elapsed = GetSeconds(begin, end);
+	if (elapsed < MAX_SAMPLE_SECONDS) {
+		seconds[phase] += std::max(elapsed - CLOCK_OVERHEAD, 0.0) * OBJ::LoadStats::SAMPLE_INTERVAL;
+	}
+}
+
+static int GetParsePhase(const std::string &type)
+{
+	if (type == "v" || type == "vt" || type == "vn") { return OBJ::LoadStats::PARSE_VERTICES; }
+	if (type == "f") { return OBJ::LoadStats::PARSE_FACES; }
+	return OBJ::LoadStats::PARSE_OTHER;
+}
+
+// map files are only checked for existence, opening them can be slow on network file systems
+static bool FileExists(const std::string &filename, OBJ::LoadStats *stats)
+{
+	const Clock::time_point start = Clock::now();
+	struct stat info;
+	const bool exists = stat(filename.c_str(), &info) == 0 && (info.st_mode & S_IFMT) != S_IFDIR;
+	if (stats != NULL) {
+		stats->seconds[OBJ::LoadStats::CHECK_MAPS] += GetSeconds(start, Clock::now());
+	}
+	return exists;
+}
+
+// negates data[component], data[component+stride], data[component+stride*2] ...
+// the SSE path flips sign bits using a mask that repeats every 12 floats (divisible by both Step_v and Step_vn)
+static void NegateComponent(float *data, int count, int stride, int component)
+{
+	static const int PATTERN_SIZE = 12;
+	int i = 0;
+#ifdef OBJ_USE_SSE
+	float pattern[PATTERN_SIZE];
+	for (int j = 0; j < PATTERN_SIZE; ++j) {
+		pattern[j] = (j % stride == component) ? -0.0f : 0.0f;
+	}
+	const __m128 mask0 = _mm_loadu_ps(pattern);
+	const __m128 mask1 = _mm_loadu_ps(pattern + 4);
+	const __m128 mask2 = _mm_loadu_ps(pattern + 8);
+	for (; i + PATTERN_SIZE <= count; i += PATTERN_SIZE) {
+		_mm_storeu_ps(data + i,     _mm_xor_ps(_mm_loadu_ps(data + i),     mask0));
+		_mm_storeu_ps(data + i + 4, _mm_xor_ps(_mm_loadu_ps(data + i + 4), mask1));
+		_mm_storeu_ps(data + i + 8, _mm_xor_ps(_mm_loadu_ps(data + i + 8), mask2));
+	}
+#endif
+	for (i += component; i < count; i += stride) {
+		data[i] = -data[i];
+	}
+}
+
 MTL::MTL( void )
 {
 	newmtl = "default";
@@ -31,8 +114,128 @@ MTL::MTL( void )
 }
 
 OBJ::OBJ( void ) : 
-	file(), o(), v(NULL), vt(NULL), vn(NULL), newmtl(NULL), f(NULL), usemtl(NULL), g(NULL), shadow_obj(), lod(NULL), num_v(0), num_vt(0), num_vn(0), num_f(0), num_usemtl(0), num_g(0), num_newmtl(0)
+	file(), o(), v(NULL), vt(NULL), vn(NULL), newmtl(NULL), f(NULL), usemtl(NULL), g(), shadow_obj(), lod(NULL), num_v(0), num_vt(0), num_vn(0), num_f(0), num_usemtl(0), num_g(0), num_newmtl(0)
+{
+}
+
+static inline bool IsBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+static inline bool IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+// The numeric readers below replace std::istream::operator>> for parameters.
+// They do not allocate and do not depend on the current locale (the decimal
+// separator is always '.'). A value must be followed by a blank or the end
+// of the line, otherwise it is not considered a value at all.
+bool OBJ::ReadValue(const char *&in, const char *end, float &out)
+{
+	static const double POW10[] = {
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	static const int MAX_EXACT_POW10 = 22;
+	static const unsigned long long MANTISSA_LIMIT = 1000000000000000000ULL; // more digits than that do not affect a float
+
+	while (in < end && IsBlank(*in)) { ++in; }
+	const char *p = in;
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		++p;
+	}
+
+	unsigned long long mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	for (; p < end && IsDigit(*p); ++p, ++digits) {
+		if (mantissa < MANTISSA_LIMIT) {
+			mantissa = mantissa * 10 + (unsigned long long)(*p - '0');
+		} else {
+			++exponent;
+		}
+	}
+	if (p < end && *p == '.') {
+		for (++p; p < end && IsDigit(*p); ++p, ++digits) {
+			if (mantissa < MANTISSA_LIMIT) {
+				mantissa = mantissa * 10 + (unsigned long long)(*p - '0');
+				--exponent;
+			}
+		}
+	}
+	if (digits == 0) { return false; }
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		++p;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negativeExponent = (*p == '-');
+			++p;
+		}
+		if (p == end || !IsDigit(*p)) { return false; }
+		int e = 0;
+		for (; p < end && IsDigit(*p); ++p) {
+			if (e < 10000) { e = e * 10 + (*p - '0'); }
+		}
+		exponent += negativeExponent ? -e : e;
+	}
+	if (p < end && !IsBlank(*p)) { return false; }
+
+	double value = (double)mantissa;
+	if (mantissa != 0 && exponent != 0) {
+		if (exponent > 0 && exponent <= MAX_EXACT_POW10) {
+			value *= POW10[exponent];
+		} else if (exponent < 0 && exponent >= -MAX_EXACT_POW10) {
+			value /= POW10[-exponent];
+		} else {
+			value *= pow(10.0, exponent);
+		}
+	}
+	out = (float)(negative ? -value : value);
+	in = p;
+	return true;
+}
+
+bool OBJ::ReadValue(const char *&in, const char *end, int &out)
+{
+	while (in < end && IsBlank(*in)) { ++in; }
+	const char *p = in;
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = (*p == '-');
+		++p;
+	}
+	if (p == end || !IsDigit(*p)) { return false; }
+
+	long long value = 0;
+	for (; p < end && IsDigit(*p); ++p) {
+		value = value * 10 + (*p - '0');
+		if (value > 2147483648LL) { return false; } // does not fit in an int
+	}
+	if (p < end && !IsBlank(*p)) { return false; }
+	if (negative) { value = -value; }
+	if (value > 2147483647LL) { return false; }
+
+	out = (int)value;
+	in = p;
+	return true;
+}
+
+bool OBJ::ReadValue(const char *&in, const char *end, std::string &out)
 {
+	while (in < end && IsBlank(*in)) { ++in; }
+	const char *p = in;
+	while (p < end && !IsBlank(*p)) { ++p; }
+	if (p == in) { return false; }
+	out.assign(in, p);
+	in = p;
+	return true;
 }
 
 void OBJ::ReadLine(File &file) const
@@ -43,6 +246,7 @@ void OBJ::ReadLine(File &file) const
 	std::string line;
 	std::getline(file.fin, line);
 	++file.lineNo;
+	file.bytesRead += (long long)line.size() + (file.fin.eof() ? 0 : 1);
 	std::istringstream sin(line);
 	sin >> file.type;
 	std::getline(sin, file.params);
@@ -80,7 +284,8 @@ void OBJ::Free(OBJ *LOD)
 	delete [] LOD->newmtl;
 	delete [] LOD->f;
 	delete [] LOD->usemtl;
-	delete [] LOD->g;
+	delete [] LOD->g.names;
+	delete [] LOD->g.ids;
 	delete LOD->lod;
 
 	LOD->v = NULL;
@@ -89,7 +294,8 @@ void OBJ::Free(OBJ *LOD)
 	LOD->newmtl = NULL;
 	LOD->f = NULL;
 	LOD->usemtl = NULL;
-	LOD->g = NULL;
+	LOD->g.names = NULL;
+	LOD->g.ids = NULL;
 	LOD->lod = NULL;
 	
 	LOD->num_v = 0;
@@ -98,6 +304,7 @@ void OBJ::Free(OBJ *LOD)
 	LOD->num_newmtl = 0;
 	LOD->num_f = 0;
 	LOD->num_usemtl = 0;
+	LOD->g.num_names = 0;
 	LOD->num_g = 0;
 }
 
@@ -111,9 +318,12 @@ void OBJ::Free(OBJ *LOD)
 // BUG: "mtllib" and "map_Ka" "shadow_obj" do not handle paths with spaces properly. Add support for "-token.
 // Remove the possibility to input several filenames in mtllib, map_Ka et al. Not necessary.
 // For every LOD all materials need to be reread and restored, even if it has it in common with other LOD:s
-OBJ::OBJ(const std::string &filename) :
-	file(filename), o(), v(NULL), vt(NULL), vn(NULL), newmtl(NULL), f(NULL), usemtl(NULL), g(NULL), shadow_obj(), lod(NULL), num_v(0), num_vt(0), num_vn(0), num_f(0), num_usemtl(0), num_g(0), num_newmtl(0)
+OBJ::OBJ(const std::string &filename, LoadStats *stats) :
+	file(filename), o(), v(NULL), vt(NULL), vn(NULL), newmtl(NULL), f(NULL), usemtl(NULL), g(), shadow_obj(), lod(NULL), num_v(0), num_vt(0), num_vn(0), num_f(0), num_usemtl(0), num_g(0), num_newmtl(0)
 {
+	const Clock::time_point start = Clock::now();
+	if (stats != NULL) { *stats = LoadStats(); }
+
 	static const int OBJ_NUM_KEYWORDS = 37;
 	static const std::string OBJ_KEYWORDS[OBJ_NUM_KEYWORDS] = {
 		"v", // supported
@@ -184,10 +394,23 @@ OBJ::OBJ(const std::string &filename) :
 	objFile.lineNo = 0;
 	objFile.fin.open(objFile.name.c_str());
 	if (objFile.fin.is_open()) {
+		std::map<std::string, size_t>::iterator lineCount; // of the previous line (lines of the same kind usually follow each other)
+		bool hasLineCount = false;
 		while (!objFile.fin.eof()) {
 
+			// every SAMPLE_INTERVAL:th line is timed, see LoadStats
+			const bool sample = stats != NULL && objFile.lineNo % LoadStats::SAMPLE_INTERVAL == 0;
+			Clock::time_point lineStart, lineRead;
+			size_t allocations = 0;
+			if (sample) { lineStart = Clock::now(); }
+
 			ReadLine(objFile);
 
+			if (sample) {
+				lineRead = Clock::now();
+				allocations = currentLod->GetAllocations();
+			}
+
 			if (objFile.type == "o") {
 				// read object name
 				// must be a name without spaces
@@ -334,7 +557,7 @@ OBJ::OBJ(const std::string &filename) :
 				// check consistency
 			}*/
 			else if (objFile.type == "g") {
-				currentLod->state.g = objFile.params;
+				currentLod->state.g = currentLod->AddGroup(objFile.params);
 			} else if (objFile.type == "usemtl") {
 				std::list<std::string> mtlname;
 				ReadParams(objFile, 1, 1, std::string(), mtlname);
@@ -351,6 +574,8 @@ OBJ::OBJ(const std::string &filename) :
 					currentLod->state.usemtl = -1;
 				}
 			}  else if (objFile.type == "mtllib") {
+				const Clock::time_point mtlStart = Clock::now();
+				const double mapSeconds = (stats != NULL) ? stats->seconds[LoadStats::CHECK_MAPS] : 0.0;
 				std::list<std::string> mtlfiles;
 				ReadParams(objFile, 1, mtlfiles);
 				std::list<std::string>::const_iterator mtlfileIt;
@@ -510,11 +735,9 @@ OBJ::OBJ(const std::string &filename) :
 								std::list<std::string> tempMap;
 								ReadParams(mtlFile, 1, tempMap);
 								if (tempMap.size() > 0) {
-									File mapFile;
 									mtl->map_Ka = "";
-									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end() && !mapFile.fin.is_open(); ++it) {
-										mapFile.fin.open(it->c_str());
-										if (mapFile.fin.is_open()) {
+									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end(); ++it) {
+										if (FileExists(*it, stats)) {
 											mtl->map_Ka = *it;
 											break;
 										}
@@ -524,11 +747,9 @@ OBJ::OBJ(const std::string &filename) :
 								std::list<std::string> tempMap;
 								ReadParams(mtlFile, 1, tempMap);
 								if (tempMap.size() > 0) {
-									File mapFile;
 									mtl->map_Kd = "";
-									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end() && !mapFile.fin.is_open(); ++it) {
-										mapFile.fin.open(it->c_str());
-										if (mapFile.fin.is_open()) {
+									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end(); ++it) {
+										if (FileExists(*it, stats)) {
 											mtl->map_Kd = *it;
 											break;
 										}
@@ -538,11 +759,9 @@ OBJ::OBJ(const std::string &filename) :
 								std::list<std::string> tempMap;
 								ReadParams(mtlFile, 1, tempMap);
 								if (tempMap.size() > 0) {
-									File mapFile;
 									mtl->map_Ks = "";
-									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end() && !mapFile.fin.is_open(); ++it) {
-										mapFile.fin.open(it->c_str());
-										if (mapFile.fin.is_open()) {
+									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end(); ++it) {
+										if (FileExists(*it, stats)) {
 											mtl->map_Ks = *it;
 											break;
 										}
@@ -552,11 +771,9 @@ OBJ::OBJ(const std::string &filename) :
 								std::list<std::string> tempMap;
 								ReadParams(mtlFile, 1, tempMap);
 								if (tempMap.size() > 0) {
-									File mapFile;
 									mtl->map_Ke = "";
-									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end() && !mapFile.fin.is_open(); ++it) {
-										mapFile.fin.open(it->c_str());
-										if (mapFile.fin.is_open()) {
+									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end(); ++it) {
+										if (FileExists(*it, stats)) {
 											mtl->map_Ke = *it;
 											break;
 										}
@@ -566,11 +783,9 @@ OBJ::OBJ(const std::string &filename) :
 								std::list<std::string> tempMap;
 								ReadParams(mtlFile, 1, tempMap);
 								if (tempMap.size() > 0) {
-									File mapFile;
 									mtl->map_Tf = "";
-									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end() && !mapFile.fin.is_open(); ++it) {
-										mapFile.fin.open(it->c_str());
-										if (mapFile.fin.is_open()) {
+									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end(); ++it) {
+										if (FileExists(*it, stats)) {
 											mtl->map_Tf = *it;
 											break;
 										}
@@ -580,11 +795,9 @@ OBJ::OBJ(const std::string &filename) :
 								std::list<std::string> tempMap;
 								ReadParams(mtlFile, 1, tempMap);
 								if (tempMap.size() > 0) {
-									File mapFile;
 									mtl->map_Ks = "";
-									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end() && !mapFile.fin.is_open(); ++it) {
-										mapFile.fin.open(it->c_str());
-										if (mapFile.fin.is_open()) {
+									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end(); ++it) {
+										if (FileExists(*it, stats)) {
 											mtl->map_Ks = *it;
 											break;
 										}
@@ -594,11 +807,9 @@ OBJ::OBJ(const std::string &filename) :
 								std::list<std::string> tempMap;
 								ReadParams(mtlFile, 1, tempMap);
 								if (tempMap.size() > 0) {
-									File mapFile;
 									mtl->map_Tr = "";
-									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end() && !mapFile.fin.is_open(); ++it) {
-										mapFile.fin.open(it->c_str());
-										if (mapFile.fin.is_open()) {
+									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end(); ++it) {
+										if (FileExists(*it, stats)) {
 											mtl->map_Tr = *it;
 											break;
 										}
@@ -608,11 +819,9 @@ OBJ::OBJ(const std::string &filename) :
 								std::list<std::string> tempMap;
 								ReadParams(mtlFile, 1, tempMap);
 								if (tempMap.size() > 0) {
-									File mapFile;
 									mtl->map_d = "";
-									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end() && !mapFile.fin.is_open(); ++it) {
-										mapFile.fin.open(it->c_str());
-										if (mapFile.fin.is_open()) {
+									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end(); ++it) {
+										if (FileExists(*it, stats)) {
 											mtl->map_d = *it;
 											break;
 										}
@@ -622,11 +831,9 @@ OBJ::OBJ(const std::string &filename) :
 								std::list<std::string> tempMap;
 								ReadParams(mtlFile, 1, tempMap);
 								if (tempMap.size() > 0) {
-									File mapFile;
 									mtl->disp = "";
-									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end() && !mapFile.fin.is_open(); ++it) {
-										mapFile.fin.open(it->c_str());
-										if (mapFile.fin.is_open()) {
+									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end(); ++it) {
+										if (FileExists(*it, stats)) {
 											mtl->disp = *it;
 											break;
 										}
@@ -636,11 +843,9 @@ OBJ::OBJ(const std::string &filename) :
 								std::list<std::string> tempMap;
 								ReadParams(mtlFile, 1, tempMap);
 								if (tempMap.size() > 0) {
-									File mapFile;
 									mtl->decal = "";
-									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end() && !mapFile.fin.is_open(); ++it) {
-										mapFile.fin.open(it->c_str());
-										if (mapFile.fin.is_open()) {
+									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end(); ++it) {
+										if (FileExists(*it, stats)) {
 											mtl->decal = *it;
 											break;
 										}
@@ -650,11 +855,9 @@ OBJ::OBJ(const std::string &filename) :
 								std::list<std::string> tempMap;
 								ReadParams(mtlFile, 1, tempMap);
 								if (tempMap.size() > 0) {
-									File mapFile;
 									mtl->bump = "";
-									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end() && !mapFile.fin.is_open(); ++it) {
-										mapFile.fin.open(it->c_str());
-										if (mapFile.fin.is_open()) {
+									for (std::list<std::string>::const_iterator it = tempMap.begin(); it != tempMap.end(); ++it) {
+										if (FileExists(*it, stats)) {
 											mtl->bump = *it;
 											break;
 										}
@@ -692,6 +895,10 @@ OBJ::OBJ(const std::string &filename) :
 					sout << "Specified files could not be opened";
 					AddError(objFile, sout);
 				}
+				if (stats != NULL) {
+					stats->seconds[LoadStats::READ_MTL] += GetSeconds(mtlStart, Clock::now()) - (stats->seconds[LoadStats::CHECK_MAPS] - mapSeconds);
+					stats->bytesRead += mtlFile.bytesRead;
+				}
 			} else if (objFile.type == "shadow_obj") {
 				currentLod->shadow_obj = objFile.params;
 			} else if (objFile.type == "lod") {
@@ -724,6 +931,21 @@ OBJ::OBJ(const std::string &filename) :
 					AddError(objFile, sout);
 				}
 			}
+
+			if (stats != NULL) {
+				const char *keyword = (objFile.type.empty() || objFile.type[0] == '#') ? "#" : objFile.type.c_str();
+				if (!hasLineCount || lineCount->first != keyword) {
+					lineCount = stats->lines.insert(std::make_pair(std::string(keyword), (size_t)0)).first;
+					hasLineCount = true;
+				}
+				++lineCount->second;
+				if (sample) {
+					AddSample(stats->seconds, LoadStats::READ_LINES, lineStart, lineRead);
+					if (objFile.type != "mtllib" && currentLod->GetAllocations() == allocations) { // material libraries and growth are not part of the line
+						AddSample(stats->seconds, GetParsePhase(objFile.type), lineRead, Clock::now());
+					}
+				}
+			}
 		}
 		if (currentLod->f.size() == 0) {
 			sout << "File does not contain any face definitions";
@@ -736,8 +958,23 @@ OBJ::OBJ(const std::string &filename) :
 		sout.str("");
 	}
 
+	if (stats != NULL) {
+		stats->bytesRead += objFile.bytesRead;
+		for (std::list<OBJ::ObjData>::const_iterator data = lodData.begin(); data != lodData.end(); ++data) {
+			stats->peakBytes += data->GetBytes();
+			stats->allocations += data->GetAllocations();
+		}
+	}
+
 	// create the main data structure
 	if (errors.size() == 0) {
+		const Clock::time_point buildStart = Clock::now();
+		if (stats != NULL) { // materials and group names are copied while the lists are still held
+			for (std::list<OBJ::ObjData>::const_iterator data = lodData.begin(); data != lodData.end(); ++data) {
+				stats->peakBytes += data->newmtl.size() * sizeof(MTL) + data->groupNames.size() * sizeof(std::string);
+				stats->allocations += (data != lodData.begin()) ? 3 : 2; // newmtl, g.names and the OBJ of the LOD
+			}
+		}
 		
 		// sort lod:s by number at time of adding
 		// place lod:s so that you access next level of detail by accessing lod->v ... lod->lod->lod->v and so on...
@@ -745,13 +982,14 @@ OBJ::OBJ(const std::string &filename) :
 		currentLod = lodData.begin();
 
 		do {
-			CreateArrayFromList(currentLod->v, &lodPtr->v, lodPtr->num_v);
-			CreateArrayFromList(currentLod->vt, &lodPtr->vt, lodPtr->num_vt);
-			CreateArrayFromList(currentLod->vn, &lodPtr->vn, lodPtr->num_vn);
+			currentLod->v.Release(&lodPtr->v, lodPtr->num_v);
+			currentLod->vt.Release(&lodPtr->vt, lodPtr->num_vt);
+			currentLod->vn.Release(&lodPtr->vn, lodPtr->num_vn);
 			CreateArrayFromList(currentLod->newmtl, &lodPtr->newmtl, lodPtr->num_newmtl);
-			CreateArrayFromList(currentLod->g, &lodPtr->g, lodPtr->num_g);
-			CreateArrayFromList(currentLod->usemtl, &lodPtr->usemtl, lodPtr->num_usemtl);
-			CreateArrayFromList(currentLod->f, &lodPtr->f, lodPtr->num_f);
+			CreateArrayFromList(currentLod->groupNames, &lodPtr->g.names, lodPtr->g.num_names);
+			currentLod->g.Release(&lodPtr->g.ids, lodPtr->num_g);
+			currentLod->usemtl.Release(&lodPtr->usemtl, lodPtr->num_usemtl);
+			currentLod->f.Release(&lodPtr->f, lodPtr->num_f);
 			//CreateArrayFromList(currentLod->p, &lodPtr->p, lodPtr->num_p);
 			//CreateArrayFromList(currentLod->l, &lodPtr->l, lodPtr->num_l);
 			lodPtr->file = file;
@@ -763,12 +1001,8 @@ OBJ::OBJ(const std::string &filename) :
 			// 1. reverse triangle winding order (this is done when triangles are read)
 			// 2. negate model's z coordinates
 			// 3. negate model's normals' z coordinates
-			for (int i = 0; i < lodPtr->num_v; i+=Step_v) { // Invert z axis
-				lodPtr->v[i+2] = -lodPtr->v[i+2];
-			}
-			for (int i = 0; i < lodPtr->num_vn; i+=Step_vn) { // Invert normals' z axis
-				lodPtr->vn[i+2] = -lodPtr->vn[i+2];
-			}
+			NegateComponent(lodPtr->v, lodPtr->num_v, Step_v, 2); // Invert z axis
+			NegateComponent(lodPtr->vn, lodPtr->num_vn, Step_vn, 2); // Invert normals' z axis
 
 			if (++currentLod != lodData.end()) {
 				lodPtr->lod = new OBJ;
@@ -778,6 +1012,12 @@ OBJ::OBJ(const std::string &filename) :
 				break;
 			}
 		} while (true);
+		if (stats != NULL) {
+			stats->seconds[LoadStats::BUILD_ARRAYS] = GetSeconds(buildStart, Clock::now());
+		}
+	}
+	if (stats != NULL) {
+		stats->totalSeconds = GetSeconds(start, Clock::now());
 	}
 }
 
@@ -835,20 +1075,16 @@ void OBJ::Reverse( void )
 		// 1. reverse triangle winding order
 		// 2. negate model's z coordinates (will this muck with winding order, i.e. do I need to change BOTH winding order and z coordinates - if no, change z coordinates)
 		// 3. negate model's normals' z coordinates
-		const int NUM_FACES = num_f / OBJ::Step_f_idx;
-		Face * const face = (Face * const)f;
+		const int NUM_FACES = lod->num_f / OBJ::Step_f;
+		Face * const face = (Face * const)lod->f;
 		for (int i = 0; i < NUM_FACES; ++i) {
 			Vertex temp = face[i].v1;
 			face[i].v1 = face[i].v3;
 			face[i].v3 = temp;
 		}
 		
-		for (int i = 0; i < lod->num_v; i+=Step_v) { // Invert z axis
-			lod->v[i+2] = -lod->v[i+2];
-		}
-		for (int i = 0; i < lod->num_vn; i+=Step_vn) { // Invert normals
-			lod->vn[i+2] = -lod->vn[i+2];
-		}
+		NegateComponent(lod->v, lod->num_v, Step_v, 2); // Invert z axis
+		NegateComponent(lod->vn, lod->num_vn, Step_vn, 2); // Invert normals
 		lod = lod->lod;
 	} while (lod != NULL);
 }
@@ -8,6 +8,7 @@
 #define OBJPARSER_H_INCLUDED__
 
 #include <list>
+#include <map>
 #include <string>
 #include <sstream>
 #include <fstream>
@@ -63,6 +64,32 @@ public:
 	static const int Step_Ni = 1;
 	static const int Step_illum = 1;
 	static const int Step_sharpness = 1;
+public:
+	// where the time and memory of a load went, see the constructor
+	// lines are too short to time one by one, so every SAMPLE_INTERVAL:th line is timed and the time is scaled up
+	// (samples that were interrupted by the scheduler or by a buffer growing are dropped)
+	struct LoadStats
+	{
+		static const int SAMPLE_INTERVAL = 64;
+		enum Phase
+		{
+			READ_LINES, // reading and splitting lines (sampled)
+			PARSE_VERTICES, // v, vt and vn (sampled)
+			PARSE_FACES, // f, including triangulation (sampled)
+			PARSE_OTHER, // all other lines (sampled)
+			READ_MTL, // material libraries (excluding CHECK_MAPS)
+			CHECK_MAPS,
+			BUILD_ARRAYS, // handing over the buffers and copying materials and group names into arrays
+			PHASE_COUNT
+		};
+		double seconds[PHASE_COUNT];
+		double totalSeconds; // wall time of the constructor
+		std::map<std::string, size_t> lines; // number of lines per keyword ("#" for comments and empty lines)
+		long long bytesRead; // of the .obj and its material libraries
+		size_t allocations; // of the buffers, materials and group names in ObjData and the arrays they are copied to, temporaries are not counted
+		size_t peakBytes; // largest number of bytes held by the buffers and materials of all LOD:s (and the arrays they are copied to) at once
+		LoadStats( void ) : seconds(), totalSeconds(0.0), lines(), bytesRead(0), allocations(0), peakBytes(0) {}
+	};
 private:
 	static const int IndexPos = 0;
 	static const int IndexTex = 1;
@@ -73,33 +100,76 @@ private:
 		std::ifstream fin;
 		std::string name;
 		int lineNo;
+		long long bytesRead;
 		std::string type;
 		std::string params;
+		File( void ) : lineNo(0), bytesRead(0) {}
+	};
+	// growable array allocated with new[] so that its memory can be handed
+	// over to the public raw pointers (v, f et al.) without copying
+	template < typename T >
+	class Buffer
+	{
+	private:
+		T *data;
+		int count;
+		int capacity;
+	public:
+		Buffer( void ) : data(NULL), count(0), capacity(0) {}
+		Buffer(const Buffer &buffer);
+		~Buffer( void ) { delete [] data; }
+		Buffer &operator=(const Buffer &buffer);
+		int size( void ) const { return count; }
+		void push_back(const T &value);
+		void pop_back( void ) { --count; }
+		void Release(T **array, int &arraySize);
+		size_t GetBytes( void ) const { return (size_t)capacity * sizeof(T); }
+		int GetAllocations( void ) const { int n = 0; for (int c = 64; c <= capacity; c *= 2) { ++n; } return n; } // see push_back
 	};
 	struct ObjData
 	{
 		
-		std::list<float> v, vn, vt;
+		Buffer<float> v, vn, vt;
 		std::list<MTL> newmtl;
-		std::list<int> f, p, l, usemtl;
-		std::list<std::string> g;
+		Buffer<int> f, usemtl;
+		std::list<int> p, l;
+		Buffer<unsigned int> g;
+		std::list<std::string> groupNames; // unique group names in order of appearance
+		std::map<std::string, unsigned int> groupIds; // group name to index into groupNames
 		std::string shadow_obj;
 		struct
 		{
 			int lod;
 			int usemtl;
-			std::string g;
+			unsigned int g;
 			void Reset( void )
 			{
 				this->lod = 0;
 				this->usemtl = -1;
-				this->g = "default";
+				this->g = 0; // "default"
 			}
 		} state;
 		ObjData( void )
 		{
+			AddGroup("default");
 			state.Reset();
 		}
+		size_t GetBytes( void ) const
+		{
+			return v.GetBytes() + vn.GetBytes() + vt.GetBytes() + f.GetBytes() + usemtl.GetBytes() + g.GetBytes() + newmtl.size() * sizeof(MTL);
+		}
+		size_t GetAllocations( void ) const // list and map nodes count as one allocation each
+		{
+			return (size_t)(v.GetAllocations() + vn.GetAllocations() + vt.GetAllocations() + f.GetAllocations() + usemtl.GetAllocations() + g.GetAllocations()) + newmtl.size() + groupNames.size() + groupIds.size();
+		}
+		unsigned int AddGroup(const std::string &name)
+		{
+			std::pair<std::map<std::string, unsigned int>::iterator, bool> entry = groupIds.insert(std::make_pair(name, (unsigned int)groupNames.size()));
+			if (entry.second) {
+				groupNames.push_back(name);
+			}
+			return entry.first->second;
+		}
 	};
 private:
 	OBJ( void );
@@ -108,12 +178,28 @@ private:
 	void AddError(const File &file, std::ostringstream &sout);
 	void AddWarning(const File &file, std::ostringstream &sout);
 	void Free(OBJ *LOD);
-	template < typename T >
-	void ReadParams(const File &file, int minParams, int maxParams, const T &defaultValue, std::list<T> &out);
+	static bool ReadValue(const char *&in, const char *end, float &out);
+	static bool ReadValue(const char *&in, const char *end, int &out);
+	static bool ReadValue(const char *&in, const char *end, std::string &out);
+	template < typename T, typename list_t >
+	void ReadParams(const File &file, int minParams, int maxParams, const T &defaultValue, list_t &out);
 	template < typename T >
 	void ReadParams(const File &file, int minParams, std::list<T> &out);
 	template < typename T >
 	void CreateArrayFromList(const std::list<T> &list, T **array, int &arraySize);
+public:
+	// group names are stored once per LOD and faces only store an index into them
+	// g[i] still reads as the group name of face i
+	class GroupTable
+	{
+	public:
+		std::string *names; // unique group names
+		unsigned int *ids; // index into names per face
+		int num_names;
+	public:
+		GroupTable( void ) : names(NULL), ids(NULL), num_names(0) {}
+		const std::string &operator[](int face) const { return names[ids[face]]; }
+	};
 public:
 	std::string file;
 	std::string o;
@@ -127,7 +213,7 @@ public:
 	// face definition and properties
 	int *f; // vertex index of triangles - converted and stored as triangles
 	int *usemtl; // what material the face uses - a material is always stored per face, even if not explicitly in the .obj file
-	std::string *g; // a group of tokens that identify faces - a group is always stored per face, even if not explicitly in the .obj file
+	GroupTable g; // a group of tokens that identify faces - a group is always stored per face, even if not explicitly in the .obj file
 	// next level of detail
 	OBJ *lod; // pointer to model containing the next level of detail (freeing this memory requires recursive freeing i.e. delete this->lod...->lod)
 	// size properies
@@ -147,7 +233,7 @@ public:
 	// Reversing winding order
 	// Negating z coordinates
 	// Inverting normals
-	explicit OBJ(const std::string &filename);
+	explicit OBJ(const std::string &filename, LoadStats *stats = NULL); // stats are filled in if not NULL
 public:
 	bool HasErrors( void ) const { return errors.size() != 0; }
 	bool HasWarnings( void ) const { return warnings.size() != 0; }
@@ -172,12 +258,60 @@ void OBJ::CreateArrayFromList(const std::list<T> &list, T **array, int &arraySiz
 }
 
 template < typename T >
-void OBJ::ReadParams(const File &file, int minParams, int maxParams, const T &defaultValue, std::list<T> &out)
+OBJ::Buffer<T>::Buffer(const Buffer &buffer) : data(NULL), count(0), capacity(0)
+{
+	*this = buffer;
+}
+
+template < typename T >
+OBJ::Buffer<T> &OBJ::Buffer<T>::operator=(const Buffer &buffer)
+{
+	if (this != &buffer) {
+		delete [] data;
+		data = (buffer.capacity > 0) ? new T[buffer.capacity] : NULL;
+		count = buffer.count;
+		capacity = buffer.capacity;
+		for (int i = 0; i < count; ++i) {
+			data[i] = buffer.data[i];
+		}
+	}
+	return *this;
+}
+
+template < typename T >
+void OBJ::Buffer<T>::push_back(const T &value)
 {
-	std::istringstream sin(file.params);
+	if (count == capacity) {
+		capacity = (capacity > 0) ? capacity * 2 : 64;
+		T *newData = new T[capacity];
+		for (int i = 0; i < count; ++i) {
+			newData[i] = data[i];
+		}
+		delete [] data;
+		data = newData;
+	}
+	data[count++] = value;
+}
+
+// hands over the allocated memory (the buffer is empty afterwards)
+template < typename T >
+void OBJ::Buffer<T>::Release(T **array, int &arraySize)
+{
+	*array = data;
+	arraySize = count;
+	data = NULL;
+	count = 0;
+	capacity = 0;
+}
+
+template < typename T, typename list_t >
+void OBJ::ReadParams(const File &file, int minParams, int maxParams, const T &defaultValue, list_t &out)
+{
+	const char *in = file.params.data();
+	const char *end = in + file.params.size();
 	int numParams = 0;
 	T value;
-	while (sin >> value) {
+	while (ReadValue(in, end, value)) {
 		out.push_back(value);
 		++numParams;
 	}
@@ -190,7 +324,7 @@ void OBJ::ReadParams(const File &file, int minParams, int maxParams, const T &de
 		sout << ")";
 		AddError(file, sout);
 		for (int i = 0; i < numParams; ++i) {
-			out.erase(--out.end()); // not sure this will work
+			out.pop_back();
 		}
 	} else {
 		for (int i = numParams; i < maxParams; ++i) {
@@ -202,10 +336,11 @@ void OBJ::ReadParams(const File &file, int minParams, int maxParams, const T &de
 template < typename T >
 void OBJ::ReadParams(const File &file, int minParams, std::list<T> &out)
 {
-	std::istringstream sin(file.params);
+	const char *in = file.params.data();
+	const char *end = in + file.params.size();
 	int numParams = 0;
 	T value;
-	while (sin >> value) {
+	while (ReadValue(in, end, value)) {
 		out.push_back(value);
 		++numParams;
 	}